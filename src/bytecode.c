@@ -161,13 +161,50 @@ static head_t *tree_to_str_xml( program_t *prg, tree_t **sp, tree_t *tree, int t
 	colm_print_tree_collect_xml( prg, sp, &collect, tree, trim );
 
 	/* Set up the input stream. */
-	head_t *ret = string_alloc_full( prg, collect.data, collect.length );
+	head_t *ret = str_collect_take( &collect );
 
-	str_collect_destroy( &collect );
+	return ret;
+}
+
+static head_t *tree_to_str_json( program_t *prg, tree_t **sp, tree_t *tree, int flags )
+{
+	str_collect_t collect;
+	init_str_collect( &collect );
+
+	colm_print_tree_collect_json( prg, sp, &collect, tree, flags );
+
+	head_t *ret = str_collect_take( &collect );
 
 	return ret;
 }
 
+static void print_json( program_t *prg, tree_t **sp, stream_t *stream, tree_t *tree, int flags )
+{
+	struct stream_impl_data *si = (struct stream_impl_data*) stream_to_impl( stream );
+	if ( si->file != 0 )
+		colm_print_json_file( prg, sp, si, tree, flags );
+	else if ( si->collect != 0 )
+		colm_print_tree_collect_json( prg, sp, si->collect, tree, flags );
+}
+
+/* Postfix data that is truncated, not postfix data at all, or that does not
+ * fit the program's tables. Reported through the error global. */
+static void read_reduce_error( program_t *prg, tree_t **sp, stream_t *stream )
+{
+	struct stream_impl_data *si = (struct stream_impl_data*) stream_to_impl( stream );
+	const char *name = si->name != 0 ? si->name : "<input>";
+
+	char *formatted = malloc( strlen( name ) + 64 );
+	sprintf( formatted, "%s: malformed postfix data", name );
+	head_t *head = string_alloc_full( prg, formatted, strlen( formatted ) );
+	free( formatted );
+
+	tree_t *error = construct_string( prg, head );
+	colm_tree_upref( prg, error );
+	colm_tree_downref( prg, sp, prg->error );
+	prg->error = error;
+}
+
 static head_t *tree_to_str_xml_ac( program_t *prg, tree_t **sp, tree_t *tree, int trim, int attrs )
 {
 	/* Collect the tree data. */
@@ -177,9 +214,19 @@ static head_t *tree_to_str_xml_ac( program_t *prg, tree_t **sp, tree_t *tree, in
 	colm_print_tree_collect_xml_ac( prg, sp, &collect, tree, trim );
 
 	/* Set up the input stream. */
-	head_t *ret = string_alloc_full( prg, collect.data, collect.length );
+	head_t *ret = str_collect_take( &collect );
+
+	return ret;
+}
 
-	str_collect_destroy( &collect );
+static head_t *tree_to_str_postfix_bin( program_t *prg, tree_t **sp, tree_t *tree )
+{
+	str_collect_t collect;
+	init_str_collect( &collect );
+
+	colm_postfix_bin_tree_collect( prg, sp, &collect, tree );
+
+	head_t *ret = str_collect_take( &collect );
 
 	return ret;
 }
@@ -193,9 +240,7 @@ static head_t *tree_to_str_postfix( program_t *prg, tree_t **sp, tree_t *tree, i
 	colm_postfix_tree_collect( prg, sp, &collect, tree, trim );
 
 	/* Set up the input stream. */
-	head_t *ret = string_alloc_full( prg, collect.data, collect.length );
-
-	str_collect_destroy( &collect );
+	head_t *ret = str_collect_take( &collect );
 
 	return ret;
 }
@@ -488,23 +533,23 @@ static list_t *construct_stds( program_t *prg )
  * Execution environment
  */
 
-void colm_rcode_downref_all( program_t *prg, tree_t **sp, struct rt_code_vect *rev )
+void colm_rcode_downref_all( program_t *prg, tree_t **sp, struct rcode_arena *rev )
 {
-	while ( rev->tab_len > 0 ) {
-		/* Read the length */
-		code_t *prcode = rev->data + rev->tab_len - SIZEOF_WORD;
-		word_t len;
-		read_word_p( len, prcode );
-
-		/* Find the start of block. */
-		long start = rev->tab_len - len - SIZEOF_WORD;
-		prcode = rev->data + start;
-
-		/* Execute it. */
+	while ( rev->top != 0 ) {
+		code_t *prcode = colm_pop_reverse_code( rev );
 		rcode_downref( prg, sp, prcode );
+	}
+}
 
-		/* Backup over it. */
-		rev->tab_len -= len + SIZEOF_WORD;
+/* Collect the heap if enough has been allocated. Called only at points where
+ * every live struct is reachable from the VM stack or the execution. Nested
+ * executions keep C locals that the collector cannot see, so skip those. */
+static void gc_safe_point( program_t *prg, execution_t *exec, tree_t **sp )
+{
+	if ( prg->gc_allocated > prg->gc_threshold && prg->gc_enabled && prg->gc_nest == 0 ) {
+		vm_push_parser( exec->parser );
+		colm_gc_collect( prg, sp );
+		vm_pop_ignore();
 	}
 }
 
@@ -657,9 +702,102 @@ tree_t *colm_run_func( struct colm_program *prg, int frame_id,
 	return prg->return_val;
 };
 
+/* Pushed data is parsed as far as it goes. Reaching the end of what is there
+ * returns PCR_DONE, same as a send statement. */
+static code_t push_parse_code[] = { IN_PARSE_FRAG_W, IN_FN, FN_STOP };
+static code_t push_finish_code[] = { IN_SEND_EOF_W, IN_PARSE_FRAG_W, IN_FN, FN_STOP };
+
+static void push_parser_run( program_t *prg, parser_t *parser, code_t *code )
+{
+	execution_t execution;
+	memset( &execution, 0, sizeof(execution) );
+	execution.frame_id = -1;
+	execution.steps = parser->pda_run->steps;
+	execution.pcr = PCR_START;
+
+	tree_t **sp = prg->stack_root;
+	vm_push_parser( parser );
+
+	sp = colm_execute_code( prg, &execution, sp, code );
+
+	vm_pop_ignore();
+	assert( sp == prg->stack_root );
+}
+
+struct colm_push_parser *colm_push_parser_new( program_t *prg, int lel_id )
+{
+	long parser_id;
+	for ( parser_id = 0; parser_id < prg->rtd->num_parsers; parser_id++ ) {
+		if ( prg->rtd->parser_lel_ids[parser_id] == lel_id )
+			break;
+	}
+
+	if ( parser_id == prg->rtd->num_parsers )
+		return 0;
+
+	struct generic_info gi;
+	memset( &gi, 0, sizeof(gi) );
+	gi.type = GEN_PARSER;
+	gi.parser_id = parser_id;
+
+	parser_t *parser = colm_parser_new( prg, &gi, 0, 0 );
+	parser->input = colm_input_new( prg );
+
+	struct colm_push_parser *pp = malloc( sizeof(struct colm_push_parser) );
+	pp->parser = parser;
+	pp->prev = 0;
+	pp->next = prg->push_parsers;
+	if ( prg->push_parsers != 0 )
+		prg->push_parsers->prev = pp;
+	prg->push_parsers = pp;
+	return pp;
+}
+
+void colm_push_parser_feed( program_t *prg, struct colm_push_parser *pp,
+		const char *data, long length )
+{
+	struct input_impl *si = input_to_impl( pp->parser->input );
+	si->funcs->append_data( prg, si, colm_alph_from_cstr( data ), length );
+
+	push_parser_run( prg, pp->parser, push_parse_code );
+}
+
+tree_t *colm_push_parser_finish( program_t *prg, struct colm_push_parser *pp )
+{
+	parser_t *parser = pp->parser;
+	tree_t **sp = prg->stack_root;
+
+	push_parser_run( prg, parser, push_finish_code );
+
+	struct pda_run *pda_run = parser->pda_run;
+	tree_t *tree = get_parsed_root( pda_run, pda_run->stop_target > 0 );
+	if ( tree == 0 ) {
+		colm_tree_upref( prg, pda_run->parse_error_text );
+		colm_tree_downref( prg, sp, prg->error );
+		prg->error = pda_run->parse_error_text;
+	}
+
+	colm_tree_upref( prg, tree );
+	colm_tree_downref( prg, sp, parser->result );
+	parser->result = tree;
+	return tree;
+}
+
+/* The parser is left to the collector. */
+void colm_push_parser_delete( program_t *prg, struct colm_push_parser *pp )
+{
+	if ( pp->prev == 0 )
+		prg->push_parsers = pp->next;
+	else
+		pp->prev->next = pp->next;
+	if ( pp->next != 0 )
+		pp->next->prev = pp->prev;
+	free( pp );
+}
+
 int colm_make_reverse_code( struct pda_run *pda_run )
 {
-	struct rt_code_vect *reverse_code = &pda_run->reverse_code;
+	struct rcode_arena *reverse_code = &pda_run->reverse_code;
 	struct rt_code_vect *rcode_collect = &pda_run->rcode_collect;
 
 	/* Do we need to revert the left hand side? */
@@ -670,29 +808,42 @@ int colm_make_reverse_code( struct pda_run *pda_run )
 
 	if ( pda_run->rc_block_count == 0 ) {
 		/* One reverse code run for the DECK terminator. */
-		append_code_val( reverse_code, IN_PCR_END_DECK );
-		append_code_val( reverse_code, IN_PCR_RET );
-		append_word( reverse_code, 2 );
+		code_t end_deck[] = { IN_PCR_END_DECK, IN_PCR_RET };
+		colm_rcode_reserve( reverse_code, sizeof(end_deck) + SIZEOF_WORD );
+		colm_rcode_append( reverse_code, end_deck, sizeof(end_deck) );
+		colm_rcode_append_word( reverse_code, sizeof(end_deck) );
 		pda_run->rc_block_count += 1;
 		colm_increment_steps( pda_run );
 	}
 
-	long start_length = reverse_code->tab_len;
+	/* Each group in the collect buffer is followed by a byte giving its
+	 * length. The block is the groups without those, then a return and the
+	 * total length. It must be contiguous. */
+	long length = SIZEOF_CODE;
+	code_t *p = rcode_collect->data + rcode_collect->tab_len;
+	while ( p != rcode_collect->data ) {
+		p--;
+		long len = *p;
+		p = p - len;
+		length += len;
+	}
+
+	colm_rcode_reserve( reverse_code, length + SIZEOF_WORD );
 
 	/* Go backwards, group by group, through the reverse code. Push each group
 	 * to the global reverse code stack. */
-	code_t *p = rcode_collect->data + rcode_collect->tab_len;
+	p = rcode_collect->data + rcode_collect->tab_len;
 	while ( p != rcode_collect->data ) {
 		p--;
 		long len = *p;
 		p = p - len;
-		append_code_vect( reverse_code, p, len );
+		colm_rcode_append( reverse_code, p, len );
 	}
 
 	/* Stop, then place a total length in the global stack. */
-	append_code_val( reverse_code, IN_PCR_RET );
-	long length = reverse_code->tab_len - start_length;
-	append_word( reverse_code, length );
+	code_t ret = IN_PCR_RET;
+	colm_rcode_append( reverse_code, &ret, SIZEOF_CODE );
+	colm_rcode_append_word( reverse_code, length );
 
 	/* Clear the revere code buffer. */
 	rcode_collect->tab_len = 0;
@@ -741,19 +892,20 @@ static void rcode_word( execution_t *exec, const word_t word )
 	exec->rcode_unit_len += SIZEOF_WORD;
 }
 
-code_t *colm_pop_reverse_code( struct rt_code_vect *all_rev )
+code_t *colm_pop_reverse_code( struct rcode_arena *all_rev )
 {
+	struct rcode_chunk *top = all_rev->top;
+
 	/* Read the length */
-	code_t *prcode = all_rev->data + all_rev->tab_len - SIZEOF_WORD;
+	code_t *prcode = top->data + top->len - SIZEOF_WORD;
 	word_t len;
 	read_word_p( len, prcode );
 
 	/* Find the start of block. */
-	long start = all_rev->tab_len - len - SIZEOF_WORD;
-	prcode = all_rev->data + start;
+	prcode = top->data + top->len - len - SIZEOF_WORD;
 
 	/* Backup over it. */
-	all_rev->tab_len -= len + SIZEOF_WORD;
+	colm_rcode_drop( all_rev, len + SIZEOF_WORD );
 	return prcode;
 }
 
@@ -838,11 +990,12 @@ again:
 			read_half( generic_id );
 			read_half( reducer_id );
 
-			input_t *input = vm_pop_input();
+			stream_t *stream = vm_pop_stream();
 
 			debug( prg, REALM_BYTECODE, "IN_READ_REDUCE %hd %hd\n", generic_id, reducer_id );
 
-			prg->rtd->read_reduce( prg, reducer_id, input );
+			if ( !prg->rtd->read_reduce( prg, reducer_id, stream ) )
+				read_reduce_error( prg, sp, stream );
 
 			vm_push_tree( 0 );
 
@@ -1107,7 +1260,7 @@ again:
 
 			tree_t *t = vm_pop_tree();
 			user_iter_t *uiter = (user_iter_t*) vm_get_local(exec, field);
-			split_ref( prg, &sp, &uiter->ref );
+			split_ref_above( prg, &sp, &uiter->ref );
 			tree_t *old = uiter->ref.kid->tree;
 			set_uiter_cur( prg, uiter, t );
 			colm_tree_downref( prg, sp, old );
@@ -1204,7 +1357,7 @@ again:
 
 			tree_t *val = vm_pop_tree();
 			ref_t *ref = (ref_t*) vm_get_plocal(exec, field);
-			split_ref( prg, &sp, ref );
+			split_ref_above( prg, &sp, ref );
 			ref_set_value( prg, sp, ref, val );
 			break;
 		}
@@ -1685,6 +1838,21 @@ again:
 			colm_tree_downref( prg, sp, tree );
 			break;
 		}
+		case IN_TREE_TO_STR_JSON:
+		case IN_TREE_TO_STR_JSON_AC: {
+			debug( prg, REALM_BYTECODE, c == IN_TREE_TO_STR_JSON ?
+					"IN_TREE_TO_STR_JSON\n" : "IN_TREE_TO_STR_JSON_AC\n" );
+
+			int flags = c == IN_TREE_TO_STR_JSON ? 0 : COLM_JSON_IGNORE | COLM_JSON_LOC;
+
+			tree_t *tree = vm_pop_tree();
+			head_t *res = tree_to_str_json( prg, sp, tree, flags );
+			tree_t *str = construct_string( prg, res );
+			colm_tree_upref( prg, str );
+			vm_push_tree( str );
+			colm_tree_downref( prg, sp, tree );
+			break;
+		}
 		case IN_TREE_TO_STR_POSTFIX: {
 			debug( prg, REALM_BYTECODE, "IN_TREE_TO_STR_XML_AC\n" );
 
@@ -1696,6 +1864,17 @@ again:
 			colm_tree_downref( prg, sp, tree );
 			break;
 		}
+		case IN_TREE_TO_STR_POSTFIX_BIN: {
+			debug( prg, REALM_BYTECODE, "IN_TREE_TO_STR_POSTFIX_BIN\n" );
+
+			tree_t *tree = vm_pop_tree();
+			head_t *res = tree_to_str_postfix_bin( prg, sp, tree );
+			tree_t *str = construct_string( prg, res );
+			colm_tree_upref( prg, str );
+			vm_push_tree( str );
+			colm_tree_downref( prg, sp, tree );
+			break;
+		}
 		case IN_TREE_TO_STR: {
 			debug( prg, REALM_BYTECODE, "IN_TREE_TO_STR\n" );
 
@@ -1814,6 +1993,7 @@ again:
 			debug( prg, REALM_BYTECODE, "IN_JMP\n" );
 
 			instr += dist;
+			gc_safe_point( prg, exec, sp );
 			break;
 		}
 		case IN_REJECT: {
@@ -1830,8 +2010,8 @@ again:
 
 			tree_t *o2 = vm_pop_tree();
 			tree_t *o1 = vm_pop_tree();
-			long r = colm_cmp_tree( prg, o1, o2 );
-			value_t val = r == 0 ? TRUE_VAL : FALSE_VAL;
+			int eq = colm_equal_tree( prg, o1, o2 );
+			value_t val = eq ? TRUE_VAL : FALSE_VAL;
 			vm_push_value( val );
 			colm_tree_downref( prg, sp, o1 );
 			colm_tree_downref( prg, sp, o2 );
@@ -1851,8 +2031,8 @@ again:
 
 			tree_t *o2 = vm_pop_tree();
 			tree_t *o1 = vm_pop_tree();
-			long r = colm_cmp_tree( prg, o1, o2 );
-			value_t val = r != 0 ? TRUE_VAL : FALSE_VAL;
+			int eq = colm_equal_tree( prg, o1, o2 );
+			value_t val = !eq ? TRUE_VAL : FALSE_VAL;
 			vm_push_value( val );
 			colm_tree_downref( prg, sp, o1 );
 			colm_tree_downref( prg, sp, o2 );
@@ -2041,6 +2221,67 @@ again:
 			vm_push_value( val );
 			break;
 		}
+		case IN_MOD_INT: {
+			debug( prg, REALM_BYTECODE, "IN_MOD_INT\n" );
+
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)o1 % (long)o2;
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
+		case IN_BIT_AND_INT: {
+			debug( prg, REALM_BYTECODE, "IN_BIT_AND_INT\n" );
+
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)o1 & (long)o2;
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
+		case IN_BIT_OR_INT: {
+			debug( prg, REALM_BYTECODE, "IN_BIT_OR_INT\n" );
+
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)o1 | (long)o2;
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
+		case IN_BIT_XOR_INT: {
+			debug( prg, REALM_BYTECODE, "IN_BIT_XOR_INT\n" );
+
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)o1 ^ (long)o2;
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
+		case IN_SHL_INT: {
+			debug( prg, REALM_BYTECODE, "IN_SHL_INT\n" );
+
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)( (ulong)o1 << ( (ulong)o2 & ( sizeof(long) * 8 - 1 ) ) );
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
+		case IN_SHR_INT: {
+			debug( prg, REALM_BYTECODE, "IN_SHR_INT\n" );
+
+			/* Arithmetic shift, sign is preserved. */
+			value_t o2 = vm_pop_value();
+			value_t o1 = vm_pop_value();
+			long r = (long)o1 >> ( (ulong)o2 & ( sizeof(long) * 8 - 1 ) );
+			value_t val = r;
+			vm_push_value( val );
+			break;
+		}
 		case IN_DUP_VAL: {
 			debug( prg, REALM_BYTECODE, "IN_DUP_VAL\n" );
 
@@ -2250,7 +2491,8 @@ again:
 
 			tree_t *tree = vm_pop_tree();
 			tree_iter_t *iter = (tree_iter_t*) vm_get_plocal(exec, field);
-			split_iter_cur( prg, &sp, iter );
+			if ( iter->ref.kid != 0 )
+				split_ref_above( prg, &sp, &iter->ref );
 			tree_t *old = tree_iter_deref_cur( iter );
 			set_triter_cur( prg, iter, tree );
 			colm_tree_downref( prg, sp, old );
@@ -2327,6 +2569,50 @@ again:
 			vm_push_tree( res );
 			break;
 		}
+		case IN_VECTOR_ITER_ADVANCE: {
+			short field;
+			read_half( field );
+
+			debug( prg, REALM_BYTECODE, "IN_VECTOR_ITER_ADVANCE\n" );
+
+			generic_iter_t *iter = (generic_iter_t*) vm_get_plocal(exec, field);
+			tree_t *res = colm_vector_iter_advance( prg, &sp, iter );
+			vm_push_tree( res );
+			break;
+		}
+		case IN_VECTOR_ITER_GET_CUR_R: {
+			short field;
+			read_half( field );
+
+			debug( prg, REALM_BYTECODE, "IN_VECTOR_ITER_GET_CUR_R\n" );
+
+			generic_iter_t *iter = (generic_iter_t*) vm_get_plocal(exec, field);
+			value_t value = colm_vector_iter_deref_cur( prg, iter );
+			vm_push_value( value );
+			break;
+		}
+		case IN_HASHMAP_ITER_ADVANCE: {
+			short field;
+			read_half( field );
+
+			debug( prg, REALM_BYTECODE, "IN_HASHMAP_ITER_ADVANCE\n" );
+
+			generic_iter_t *iter = (generic_iter_t*) vm_get_plocal(exec, field);
+			tree_t *res = colm_hashmap_iter_advance( prg, &sp, iter );
+			vm_push_tree( res );
+			break;
+		}
+		case IN_HASHMAP_ITER_GET_CUR_R: {
+			short field;
+			read_half( field );
+
+			debug( prg, REALM_BYTECODE, "IN_HASHMAP_ITER_GET_CUR_R\n" );
+
+			generic_iter_t *iter = (generic_iter_t*) vm_get_plocal(exec, field);
+			value_t value = colm_hashmap_iter_deref_cur( prg, iter );
+			vm_push_value( value );
+			break;
+		}
 		case IN_GEN_ITER_GET_CUR_R: {
 			short field;
 			read_half( field );
@@ -2371,7 +2657,26 @@ again:
 			kid_t kid;
 			kid.tree = tree;
 			kid.next = 0;
-			int matched = match_pattern( bindings, prg, root_node, &kid, false );
+
+			/* Members of a pattern set take the decision made by
+			 * IN_MATCH_SET and only walk the pattern for bindings. */
+			struct pat_cons_info *info = &prg->rtd->pat_repl_info[pattern_id];
+			struct pat_set_memo *memo = 0;
+			if ( info->set >= 0 ) {
+				memo = &prg->pat_set_memo[info->set];
+				if ( memo->tree != tree || info->set_index > memo->first )
+					memo = 0;
+			}
+
+			int matched;
+			if ( memo != 0 ) {
+				matched = info->set_index == memo->first;
+				if ( matched && num_bindings > 0 )
+					match_pattern( bindings, prg, root_node, &kid, false );
+			}
+			else {
+				matched = match_pattern( bindings, prg, root_node, &kid, false );
+			}
 
 			if ( !matched )
 				memset( bindings, 0, sizeof(tree_t*)*(1+num_bindings) );
@@ -2394,6 +2699,34 @@ again:
 			break;
 		}
 
+		case IN_MATCH_SET: {
+			half_t set;
+			read_half( set );
+
+			debug( prg, REALM_BYTECODE, "IN_MATCH_SET\n" );
+
+			tree_t *tree = vm_pop_tree();
+
+			kid_t kid;
+			kid.tree = tree;
+			kid.next = 0;
+
+			struct pat_set_memo *memo = &prg->pat_set_memo[set];
+			memo->tree = tree;
+			memo->first = colm_match_pattern_set( prg, set, &kid );
+
+			/* Jump to the if holding the first member that matched, or past
+			 * the last member. */
+			long num_members = prg->rtd->pat_sets[set].num_members;
+			short dist;
+			instr += SIZEOF_HALF * memo->first;
+			read_half( dist );
+			instr += SIZEOF_HALF * ( num_members - memo->first );
+			instr += dist;
+
+			colm_tree_downref( prg, sp, tree );
+			break;
+		}
 		case IN_PROD_NUM: {
 			debug( prg, REALM_BYTECODE, "IN_PROD_NUM\n" );
 
@@ -2648,6 +2981,22 @@ again:
 			vm_push_stream( stream );
 			break;
 		}
+		case IN_PRINT_JSON_WC:
+		case IN_PRINT_JSON_AC_WC: {
+			debug( prg, REALM_BYTECODE, c == IN_PRINT_JSON_WC ?
+					"IN_PRINT_JSON_WC\n" : "IN_PRINT_JSON_AC_WC\n" );
+
+			int flags = c == IN_PRINT_JSON_WC ? 0 : COLM_JSON_IGNORE | COLM_JSON_LOC;
+
+			stream_t *stream = vm_pop_stream();
+			tree_t *tree = vm_pop_tree();
+
+			print_json( prg, sp, stream, tree, flags );
+
+			vm_push_stream( stream );
+			colm_tree_downref( prg, sp, tree );
+			break;
+		}
 		case IN_IINPUT_AUTO_TRIM_WC: {
 			debug( prg, REALM_BYTECODE, "IN_INPUT_AUTO_TRIM_WC\n" );
 
@@ -2963,6 +3312,8 @@ again:
 			}
 
 			tree_t *repl_tree = colm_construct_tree( prg, 0, bindings, root_node );
+			if ( prg->hash_cons )
+				repl_tree = colm_hash_cons( prg, sp, repl_tree );
 
 			vm_push_tree( repl_tree );
 			break;
@@ -2975,7 +3326,8 @@ again:
 
 			/* Pop the string we are constructing the token from. */
 			str_t *str = vm_pop_string();
-			tree_t *res = colm_construct_term( prg, token_id, str->value );
+			tree_t *res = colm_construct_term( prg, token_id,
+					colm_tree_data( prg, (tree_t*)str ) );
 			colm_tree_upref( prg, res );
 			vm_push_tree( res );
 			break;
@@ -3182,6 +3534,7 @@ again:
 			head_t *head = string_copy( prg, ((str_t*)val)->value );
 			string_free( prg, tree->tokdata );
 			tree->tokdata = head;
+			tree->flags &= ~AF_HASH_VALID;
 
 			colm_tree_downref( prg, sp, tree );
 			colm_tree_downref( prg, sp, val );
@@ -3196,6 +3549,7 @@ again:
 			head_t *oldval = tree->tokdata;
 			head_t *head = string_copy( prg, ((str_t*)val)->value );
 			tree->tokdata = head;
+			tree->flags &= ~AF_HASH_VALID;
 
 			/* Set up reverse code. Needs no args. */
 			rcode_code( exec, IN_SET_TOKEN_DATA_BKT );
@@ -3216,6 +3570,7 @@ again:
 			head_t *head = (head_t*)oldval;
 			string_free( prg, tree->tokdata );
 			tree->tokdata = head;
+			tree->flags &= ~AF_HASH_VALID;
 			colm_tree_downref( prg, sp, tree );
 			break;
 		}
@@ -3292,6 +3647,24 @@ again:
 			vm_push_value( res );
 			break;
 		}
+		case IN_VECTOR_LENGTH: {
+			debug( prg, REALM_BYTECODE, "IN_VECTOR_LENGTH\n" );
+
+			vector_t *vector = vm_pop_vector();
+			long len = colm_vector_length( vector );
+			value_t res = len;
+			vm_push_value( res );
+			break;
+		}
+		case IN_HASHMAP_LENGTH: {
+			debug( prg, REALM_BYTECODE, "IN_HASHMAP_LENGTH\n" );
+
+			hashmap_t *map = vm_pop_hashmap();
+			long len = colm_hashmap_length( map );
+			value_t res = len;
+			vm_push_value( res );
+			break;
+		}
 		case IN_GET_LIST_EL_MEM_R: {
 			short gen_id, field;
 			read_half( gen_id );
@@ -3590,6 +3963,8 @@ again:
 
 			debug( prg, REALM_BYTECODE, "IN_CALL_WV %s\n", fr->name );
 
+			gc_safe_point( prg, exec, sp );
+
 			vm_contiguous( FR_AA + fi->frame_size );
 
 			vm_push_type( tree_t**, exec->call_args );
@@ -3615,6 +3990,8 @@ again:
 
 			debug( prg, REALM_BYTECODE, "IN_CALL_WC %s %d\n", fr->name, fr->frame_size );
 
+			gc_safe_point( prg, exec, sp );
+
 			vm_contiguous( FR_AA + fi->frame_size );
 
 			vm_push_type( tree_t**, exec->call_args );
@@ -3882,7 +4259,7 @@ again:
 			str_t *cmd = vm_pop_string();
 
 			char *cmd0 = malloc( cmd->value->length + 1 );
-			memcpy( cmd0, cmd->value->data, cmd->value->length );
+			memcpy( cmd0, string_data( cmd->value ), cmd->value->length );
 			cmd0[cmd->value->length] = 0;
 
 			int res = system( cmd0 );
@@ -4641,6 +5018,331 @@ again:
 				break;
 			}
 
+			case FN_VECTOR_PUSH_WC: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_PUSH_WC %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+				value_t value = vm_pop_value();
+
+				colm_vector_push( prg, vector, value );
+
+				vm_push_tree( prg->true_val );
+				break;
+			}
+			case FN_VECTOR_PUSH_WV: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_PUSH_WV %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+				value_t value = vm_pop_value();
+
+				colm_vector_push( prg, vector, value );
+
+				vm_push_tree( prg->true_val );
+
+				/* Set up reverse code. */
+				rcode_code( exec, IN_FN );
+				rcode_code( exec, FN_VECTOR_PUSH_BKT );
+				rcode_half( exec, gen_id );
+				rcode_unit_term( exec );
+				break;
+			}
+			case FN_VECTOR_PUSH_BKT: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_PUSH_BKT\n" );
+
+				vector_t *vector = vm_pop_vector();
+				value_t value = colm_vector_pop( prg, vector );
+				if ( vector->generic_info->value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)value );
+				break;
+			}
+			case FN_VECTOR_POP_WC: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_POP_WC %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+
+				value_t result = colm_vector_pop( prg, vector );
+				vm_push_value( result );
+				break;
+			}
+			case FN_VECTOR_POP_WV: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_POP_WV %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+
+				value_t result = colm_vector_pop( prg, vector );
+				vm_push_value( result );
+
+				/* The reverse code holds a reference until it is executed or
+				 * discarded. */
+				if ( vector->generic_info->value_type == TYPE_TREE )
+					colm_tree_upref( prg, (tree_t*)result );
+
+				rcode_code( exec, IN_FN );
+				rcode_code( exec, FN_VECTOR_POP_BKT );
+				rcode_half( exec, gen_id );
+				rcode_word( exec, (word_t)result );
+				rcode_unit_term( exec );
+				break;
+			}
+			case FN_VECTOR_POP_BKT: {
+				short gen_id;
+				word_t value;
+				read_half( gen_id );
+				read_word( value );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_POP_BKT\n" );
+
+				vector_t *vector = vm_pop_vector();
+				colm_vector_push( prg, vector, (value_t)value );
+				break;
+			}
+			case FN_VECTOR_GET: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_GET %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+				long pos = (long)vm_pop_value();
+
+				value_t result = colm_vector_get( prg, vector, pos );
+				vm_push_value( result );
+				break;
+			}
+			case FN_VECTOR_SET_WC: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_SET_WC %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+				value_t value = vm_pop_value();
+				long pos = (long)vm_pop_value();
+
+				value_t prev = colm_vector_set( prg, vector, pos, value );
+				if ( vector->generic_info->value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)prev );
+
+				vm_push_tree( prg->true_val );
+				break;
+			}
+			case FN_VECTOR_SET_WV: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_SET_WV %hd\n", gen_id );
+
+				vector_t *vector = vm_pop_vector();
+				value_t value = vm_pop_value();
+				long pos = (long)vm_pop_value();
+
+				long len = vector->len;
+				value_t prev = colm_vector_set( prg, vector, pos, value );
+
+				vm_push_tree( prg->true_val );
+
+				/* Reverse code takes the previous value. */
+				rcode_code( exec, IN_FN );
+				rcode_code( exec, FN_VECTOR_SET_BKT );
+				rcode_half( exec, gen_id );
+				rcode_word( exec, (word_t)pos );
+				rcode_word( exec, (word_t)len );
+				rcode_word( exec, (word_t)prev );
+				rcode_unit_term( exec );
+				break;
+			}
+			case FN_VECTOR_SET_BKT: {
+				short gen_id;
+				word_t pos, len, prev;
+				read_half( gen_id );
+				read_word( pos );
+				read_word( len );
+				read_word( prev );
+
+				debug( prg, REALM_BYTECODE, "FN_VECTOR_SET_BKT\n" );
+
+				vector_t *vector = vm_pop_vector();
+				value_t cur = colm_vector_set( prg, vector, (long)pos, (value_t)prev );
+				if ( vector->generic_info->value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)cur );
+				vector->len = (long)len;
+				break;
+			}
+
+			case FN_HASHMAP_INSERT_WC: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_INSERT_WC %hd\n", gen_id );
+
+				hashmap_t *map = vm_pop_hashmap();
+				value_t value = vm_pop_value();
+				value_t key = vm_pop_value();
+
+				int inserted = colm_hashmap_insert( prg, map, key, value );
+				if ( !inserted ) {
+					if ( map->generic_info->key_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)key );
+					if ( map->generic_info->value_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)value );
+				}
+
+				vm_push_value( (value_t)(long)inserted );
+				break;
+			}
+			case FN_HASHMAP_INSERT_WV: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_INSERT_WV %hd\n", gen_id );
+
+				hashmap_t *map = vm_pop_hashmap();
+				value_t value = vm_pop_value();
+				value_t key = vm_pop_value();
+
+				int inserted = colm_hashmap_insert( prg, map, key, value );
+				if ( !inserted ) {
+					if ( map->generic_info->key_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)key );
+					if ( map->generic_info->value_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)value );
+				}
+
+				vm_push_value( (value_t)(long)inserted );
+
+				/* The reverse code removes the key again. The table owns the
+				 * key until then. */
+				rcode_code( exec, IN_FN );
+				rcode_code( exec, FN_HASHMAP_INSERT_BKT );
+				rcode_half( exec, gen_id );
+				rcode_code( exec, inserted ? 1 : 0 );
+				rcode_word( exec, (word_t)key );
+				rcode_unit_term( exec );
+				break;
+			}
+			case FN_HASHMAP_INSERT_BKT: {
+				short gen_id;
+				uchar inserted;
+				word_t key;
+				read_half( gen_id );
+				read_byte( inserted );
+				read_word( key );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_INSERT_BKT %d\n",
+						(int)inserted );
+
+				hashmap_t *map = vm_pop_hashmap();
+				if ( inserted ) {
+					value_t rkey, rvalue;
+					colm_hashmap_remove( prg, map, (value_t)key, &rkey, &rvalue );
+					if ( map->generic_info->key_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)rkey );
+					if ( map->generic_info->value_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)rvalue );
+				}
+				break;
+			}
+			case FN_HASHMAP_REMOVE_WC: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_REMOVE_WC %hd\n", gen_id );
+
+				hashmap_t *map = vm_pop_hashmap();
+				value_t key = vm_pop_value();
+
+				value_t rkey = 0, rvalue = 0;
+				if ( colm_hashmap_remove( prg, map, key, &rkey, &rvalue ) ) {
+					if ( map->generic_info->key_type == TYPE_TREE )
+						colm_tree_downref( prg, sp, (tree_t*)rkey );
+				}
+
+				if ( map->generic_info->key_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)key );
+
+				/* Ownership of the value passes to the caller. */
+				vm_push_value( rvalue );
+				break;
+			}
+			case FN_HASHMAP_REMOVE_WV: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_REMOVE_WV %hd\n", gen_id );
+
+				hashmap_t *map = vm_pop_hashmap();
+				value_t key = vm_pop_value();
+
+				value_t rkey = 0, rvalue = 0;
+				int removed = colm_hashmap_remove( prg, map, key, &rkey, &rvalue );
+
+				if ( map->generic_info->key_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)key );
+
+				/* The reverse code keeps the removed key and value, the caller
+				 * gets its own reference to the value. */
+				if ( removed && map->generic_info->value_type == TYPE_TREE )
+					colm_tree_upref( prg, (tree_t*)rvalue );
+				vm_push_value( rvalue );
+
+				rcode_code( exec, IN_FN );
+				rcode_code( exec, FN_HASHMAP_REMOVE_BKT );
+				rcode_half( exec, gen_id );
+				rcode_code( exec, removed ? 1 : 0 );
+				rcode_word( exec, (word_t)rkey );
+				rcode_word( exec, (word_t)rvalue );
+				rcode_unit_term( exec );
+				break;
+			}
+			case FN_HASHMAP_REMOVE_BKT: {
+				short gen_id;
+				uchar removed;
+				word_t key, value;
+				read_half( gen_id );
+				read_byte( removed );
+				read_word( key );
+				read_word( value );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_REMOVE_BKT %d\n",
+						(int)removed );
+
+				hashmap_t *map = vm_pop_hashmap();
+				if ( removed )
+					colm_hashmap_insert( prg, map, (value_t)key, (value_t)value );
+				break;
+			}
+			case FN_HASHMAP_FIND: {
+				short gen_id;
+				read_half( gen_id );
+
+				debug( prg, REALM_BYTECODE, "FN_HASHMAP_FIND %hd\n", gen_id );
+
+				hashmap_t *map = vm_pop_hashmap();
+				value_t key = vm_pop_value();
+
+				value_t result = colm_hashmap_find( prg, map, key );
+				vm_push_value( result );
+
+				if ( map->generic_info->key_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, (tree_t*)key );
+				break;
+			}
+
 			case FN_EXIT_HARD: {
 				debug( prg, REALM_BYTECODE, "FN_EXIT\n" );
 
@@ -4674,8 +5376,11 @@ again:
 							( fi->name != 0 ? fi->name : "<no-name>" ),
 							unwind_len, fi->arg_size );
 
-					if ( unwind_len > 0 )
+					if ( unwind_len > 0 ) {
+						prg->gc_nest += 1;
 						sp = colm_execute_code( prg, exec, sp, instr );
+						prg->gc_nest -= 1;
+					}
 
 					downref_locals( prg, &sp, exec, fi->locals, fi->locals_len );
 					vm_popn( fi->frame_size );
@@ -4991,6 +5696,59 @@ again:
 				break;
 			}
 
+			case FN_VECTOR_PUSH_BKT: {
+				consume_half(); //( gen_id );
+				break;
+			}
+
+			case FN_VECTOR_POP_BKT: {
+				short gen_id;
+				tree_t *val;
+				read_half( gen_id );
+				read_tree( val );
+
+				if ( prg->rtd->generic_info[gen_id].value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, val );
+				break;
+			}
+
+			case FN_VECTOR_SET_BKT: {
+				short gen_id;
+				tree_t *prev;
+				read_half( gen_id );
+				consume_word(); //( pos );
+				consume_word(); //( len );
+				read_tree( prev );
+
+				if ( prg->rtd->generic_info[gen_id].value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, prev );
+				break;
+			}
+
+			case FN_HASHMAP_INSERT_BKT: {
+				consume_half(); //( gen_id );
+				consume_byte(); //( inserted );
+				consume_word(); //( key );
+				break;
+			}
+
+			case FN_HASHMAP_REMOVE_BKT: {
+				short gen_id;
+				uchar removed;
+				tree_t *key, *value;
+				read_half( gen_id );
+				read_byte( removed );
+				read_tree( key );
+				read_tree( value );
+
+				struct generic_info *gi = &prg->rtd->generic_info[gen_id];
+				if ( removed && gi->key_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, key );
+				if ( removed && gi->value_type == TYPE_TREE )
+					colm_tree_downref( prg, sp, value );
+				break;
+			}
+
 			case FN_VLIST_PUSH_TAIL_BKT: {
 				break;
 			}
@@ -51,6 +51,12 @@ typedef unsigned char uchar;
 #define IN_SUB_INT               0x09
 #define IN_MULT_INT              0x0a
 #define IN_DIV_INT               0x0b
+#define IN_MOD_INT               0xa7
+#define IN_BIT_AND_INT           0xa8
+#define IN_BIT_OR_INT            0xab
+#define IN_BIT_XOR_INT           0xac
+#define IN_SHL_INT               0xad
+#define IN_SHR_INT               0xae
 
 #define IN_TST_EQL_VAL           0x59
 #define IN_TST_EQL_TREE          0x0c
@@ -83,6 +89,10 @@ typedef unsigned char uchar;
 #define IN_LIST_ITER_ADVANCE     0xde
 #define IN_REV_LIST_ITER_ADVANCE 0x77
 #define IN_MAP_ITER_ADVANCE      0xe6
+#define IN_VECTOR_ITER_ADVANCE   0x85
+#define IN_VECTOR_ITER_GET_CUR_R 0x86
+#define IN_HASHMAP_ITER_ADVANCE  0xaf
+#define IN_HASHMAP_ITER_GET_CUR_R 0xb0
 
 #define IN_NOT_VAL               0x14
 #define IN_NOT_TREE              0xd2
@@ -105,6 +115,7 @@ typedef unsigned char uchar;
 
 #define IN_REJECT                0x21
 #define IN_MATCH                 0x22
+#define IN_MATCH_SET             0xbb
 #define IN_PROD_NUM              0x6a
 #define IN_CONSTRUCT             0x23
 #define IN_CONS_OBJECT           0xf0
@@ -203,6 +214,9 @@ typedef unsigned char uchar;
 
 #define IN_LIST_LENGTH           0x72
 
+#define IN_VECTOR_LENGTH         0x88
+#define IN_HASHMAP_LENGTH        0xb1
+
 #define IN_GET_LIST_MEM_R        0x79
 #define IN_GET_LIST_MEM_WC       0x7a
 #define IN_GET_LIST_MEM_WV       0x7b
@@ -228,6 +242,11 @@ typedef unsigned char uchar;
 #define IN_TREE_TO_STR_XML       0x6e
 #define IN_TREE_TO_STR_XML_AC    0x6f
 #define IN_TREE_TO_STR_POSTFIX   0xb6
+#define IN_TREE_TO_STR_POSTFIX_BIN 0xbc
+#define IN_TREE_TO_STR_JSON      0xce
+#define IN_TREE_TO_STR_JSON_AC   0xcf
+#define IN_PRINT_JSON_WC         0xe0
+#define IN_PRINT_JSON_AC_WC      0xf6
 
 #define IN_HOST                  0xea
 
@@ -418,6 +437,25 @@ typedef unsigned char uchar;
 #define FN_VLIST_POP_HEAD_WV     0x33
 #define FN_VLIST_POP_HEAD_WC     0x34
 #define FN_VLIST_POP_HEAD_BKT    0x35
+
+#define FN_VECTOR_PUSH_WV        0x3f
+#define FN_VECTOR_PUSH_WC        0x40
+#define FN_VECTOR_PUSH_BKT       0x41
+#define FN_VECTOR_POP_WV         0x42
+#define FN_VECTOR_POP_WC         0x43
+#define FN_VECTOR_POP_BKT        0x44
+#define FN_VECTOR_SET_WV         0x45
+#define FN_VECTOR_SET_WC         0x46
+#define FN_VECTOR_SET_BKT        0x47
+#define FN_VECTOR_GET            0x48
+
+#define FN_HASHMAP_INSERT_WV     0x49
+#define FN_HASHMAP_INSERT_WC     0x4a
+#define FN_HASHMAP_INSERT_BKT    0x4b
+#define FN_HASHMAP_REMOVE_WV     0x4c
+#define FN_HASHMAP_REMOVE_WC     0x4d
+#define FN_HASHMAP_REMOVE_BKT    0x4e
+#define FN_HASHMAP_FIND          0x4f
 #define FN_EXIT                  0x39
 #define FN_EXIT_HARD             0x3a
 #define FN_PREFIX                0x3b
@@ -431,7 +469,9 @@ typedef unsigned char uchar;
 enum GEN {
 	GEN_PARSER   = 0x14,
 	GEN_LIST     = 0x15,
-	GEN_MAP      = 0x16
+	GEN_MAP      = 0x16,
+	GEN_VECTOR   = 0x17,
+	GEN_HASHMAP  = 0x18
 };
 
 /* Known language element ids. */
@@ -469,9 +509,29 @@ enum LEL_ID {
 #define AF_LEFT_IGNORE   0x0100
 #define AF_RIGHT_IGNORE  0x0200
 
+/* Attributes and children are one contiguous kid block, indexable by
+ * position. */
+#define AF_KID_BLOCK     0x0400
+
+/* The summary field covers the ids of all grammar children, recursively.
+ * Ignores and attributes are not included. */
+#define AF_SUMMARY_VALID  0x0800
+
+/* The hash field holds the structural hash of the tree. Cleared whenever the
+ * tree or anything below it is modified. */
+#define AF_HASH_VALID     0x1000
+
+/* The tree is in the hash consing table, which holds a reference to it. */
+#define AF_HASH_CONSED    0x2000
+
 #define AF_SUPPRESS_LEFT  0x4000
 #define AF_SUPPRESS_RIGHT 0x8000
 
+/* An ignore list standing in for the single ignore token it holds. The
+ * token's id is in prod_num, its text in tokdata. The token is built on
+ * demand. Tree flags have the low byte to themselves. */
+#define AF_LAZY_IGNORE    0x0001
+
 /*
  * Call stack.
  */
@@ -539,6 +599,8 @@ enum LEL_ID {
 #define vm_pop_parser() vm_pop_type(parser_t*)
 #define vm_pop_list()   vm_pop_type(list_t*)
 #define vm_pop_map()    vm_pop_type(map_t*)
+#define vm_pop_vector() vm_pop_type(vector_t*)
+#define vm_pop_hashmap() vm_pop_type(hashmap_t*)
 #define vm_pop_value()  vm_pop_type(value_t)
 #define vm_pop_string() vm_pop_type(str_t*)
 #define vm_pop_kid()    vm_pop_type(kid_t*)
@@ -630,6 +692,8 @@ static inline void vm_set_local( struct colm_execution *exec, int o, tree_t* v )
 
 long string_length( head_t *str );
 const char *string_data( head_t *str );
+void string_pieces( head_t *head, void (*piece)( void *arg, const char *data, long length ),
+		void *arg );
 head_t *init_str_space( long length );
 head_t *string_copy( struct colm_program *prg, head_t *head );
 void string_free( struct colm_program *prg, head_t *head );
@@ -640,6 +704,7 @@ word_t str_atoo( head_t *str );
 word_t str_uord16( head_t *head );
 word_t str_uord8( head_t *head );
 word_t cmp_string( head_t *s1, head_t *s2 );
+word_t hash_string( head_t *head );
 head_t *string_to_upper( head_t *s );
 head_t *string_to_lower( head_t *s );
 head_t *string_sprintf( program_t *prg, str_t *format, long integer );
@@ -650,24 +715,26 @@ head_t *int_to_str( struct colm_program *prg, word_t i );
 void colm_execute( struct colm_program *prg, execution_t *exec, code_t *code );
 void reduction_execution( execution_t *exec, tree_t **sp );
 void generation_execution( execution_t *exec, tree_t **sp );
-void reverse_execution( execution_t *exec, tree_t **sp, struct rt_code_vect *all_rev );
+void reverse_execution( execution_t *exec, tree_t **sp, struct rcode_arena *all_rev );
 
 kid_t *alloc_attrs( struct colm_program *prg, long length );
+kid_t *alloc_kid_block( struct colm_program *prg, tree_t *tree, long length );
 void free_attrs( struct colm_program *prg, kid_t *attrs );
 kid_t *get_attr_kid( tree_t *tree, long pos );
 
 tree_t *split_tree( struct colm_program *prg, tree_t *t );
 
-void colm_rcode_downref_all( struct colm_program *prg, tree_t **sp, struct rt_code_vect *cv );
+void colm_rcode_downref_all( struct colm_program *prg, tree_t **sp, struct rcode_arena *cv );
 int colm_make_reverse_code( struct pda_run *pda_run );
 void colm_transfer_reverse_code( struct pda_run *pda_run, parse_tree_t *tree );
 
 void split_ref( struct colm_program *prg, tree_t ***sp, ref_t *from_ref );
+void split_ref_above( struct colm_program *prg, tree_t ***sp, ref_t *from_ref );
 
 void alloc_global( struct colm_program *prg );
 tree_t **colm_execute_code( struct colm_program *prg,
 	execution_t *exec, tree_t **sp, code_t *instr );
-code_t *colm_pop_reverse_code( struct rt_code_vect *all_rev );
+code_t *colm_pop_reverse_code( struct rcode_arena *all_rev );
 
 #ifdef __cplusplus
 }
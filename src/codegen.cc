@@ -51,7 +51,21 @@ void FsmCodeGen::writeMain( long activeRealm )
 		"	int exit_status;\n"
 		"\n"
 		"	prg = colm_new_program( &" << objectName << " );\n"
-		"	colm_set_debug( prg, " << activeRealm << " );\n"
+		"	colm_set_debug( prg, " << activeRealm << " );\n";
+
+	if ( gblHashCons )
+		out << "	colm_set_hash_cons( prg, 1 );\n";
+
+	if ( gblLazyIgnore )
+		out << "	colm_set_lazy_ignore( prg, 1 );\n";
+
+	if ( gblReduceThread )
+		out << "	colm_set_reduce_thread( prg, 1 );\n";
+
+	if ( gblReduceStream )
+		out << "	colm_set_reduce_stream( prg, 1 );\n";
+
+	out <<
 		"	colm_run_program( prg, argc, argv );\n"
 		"	exit_status = colm_delete_program( prg );\n"
 		"	return exit_status;\n"
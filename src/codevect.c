@@ -179,4 +179,104 @@ void colm_rt_code_vect_remove( struct rt_code_vect *vect, long pos, long len )
 	vect->tab_len = new_len;
 }
 
+void colm_rcode_init( struct rcode_arena *arena, struct rcode_stats *stats )
+{
+	arena->top = 0;
+	arena->spare = 0;
+	arena->stats = stats;
+}
+
+static struct rcode_chunk *rcode_chunk_new( struct rcode_stats *stats, long len )
+{
+	struct rcode_chunk *chunk;
+	if ( len > RCODE_CHUNK_SIZE ) {
+		chunk = (struct rcode_chunk*) malloc( sizeof(struct rcode_chunk) +
+				len - RCODE_CHUNK_SIZE );
+		chunk->alloc = len;
+	}
+	else {
+		chunk = (struct rcode_chunk*) malloc( sizeof(struct rcode_chunk) );
+		chunk->alloc = RCODE_CHUNK_SIZE;
+	}
+
+	stats->chunks += 1;
+	return chunk;
+}
+
+static void rcode_chunk_free( struct rcode_stats *stats, struct rcode_chunk *chunk )
+{
+	stats->chunks -= 1;
+	free( chunk );
+}
+
+/* Make room for a block of len bytes at the top, in one piece. */
+void colm_rcode_reserve( struct rcode_arena *arena, long len )
+{
+	struct rcode_chunk *top = arena->top;
+	if ( top != 0 && top->alloc - top->len >= len )
+		return;
+
+	struct rcode_chunk *chunk = arena->spare;
+	if ( chunk != 0 && chunk->alloc >= len )
+		arena->spare = 0;
+	else
+		chunk = rcode_chunk_new( arena->stats, len );
+
+	chunk->prev = top;
+	chunk->len = 0;
+	arena->top = chunk;
+}
 
+/* Space must have been reserved. */
+void colm_rcode_append( struct rcode_arena *arena, const code_t *data, long len )
+{
+	struct rcode_chunk *top = arena->top;
+	memcpy( top->data + top->len, data, len );
+	top->len += len;
+
+	struct rcode_stats *stats = arena->stats;
+	stats->bytes += len;
+	if ( stats->bytes > stats->peak )
+		stats->peak = stats->bytes;
+}
+
+void colm_rcode_append_word( struct rcode_arena *arena, word_t word )
+{
+	code_t data[sizeof(word_t)];
+	unsigned i;
+	for ( i = 0; i < sizeof(word_t); i++ )
+		data[i] = ( word >> ( i * 8 ) ) & 0xff;
+	colm_rcode_append( arena, data, sizeof(word_t) );
+}
+
+/* Remove len bytes from the top. An emptied chunk becomes the spare, so the
+ * code just popped from it stays readable until the next pop empties one. */
+void colm_rcode_drop( struct rcode_arena *arena, long len )
+{
+	struct rcode_chunk *top = arena->top;
+	top->len -= len;
+	arena->stats->bytes -= len;
+
+	if ( top->len == 0 ) {
+		arena->top = top->prev;
+		if ( arena->spare != 0 )
+			rcode_chunk_free( arena->stats, arena->spare );
+		arena->spare = top;
+	}
+}
+
+/* Free the chunks of an arena whose code has been dropped. */
+void colm_rcode_release( struct rcode_arena *arena )
+{
+	while ( arena->top != 0 ) {
+		struct rcode_chunk *prev = arena->top->prev;
+		arena->stats->bytes -= arena->top->len;
+		rcode_chunk_free( arena->stats, arena->top );
+		arena->top = prev;
+	}
+
+	if ( arena->spare != 0 ) {
+		rcode_chunk_free( arena->stats, arena->spare );
+		arena->spare = 0;
+	}
+}
@@ -34,6 +34,8 @@ struct colm_program;
 struct colm_sections;
 struct colm_tree;
 struct colm_location;
+struct colm_snapshot;
+struct colm_push_parser;
 
 struct indent_impl
 {
@@ -59,6 +61,13 @@ struct colm_tree
 
 	/* FIXME: this needs to go somewhere else. Will do for now. */
 	unsigned short prod_num;
+
+	/* Bitset of the ids of this tree and its children, hashed to 32 bits.
+	 * Valid when AF_SUMMARY_VALID is set. */
+	unsigned int summary;
+
+	/* Cached structural hash, valid when AF_HASH_VALID is set. */
+	unsigned int hash;
 };
 
 struct colm_print_args
@@ -99,6 +108,7 @@ struct colm_tree *colm_get_repeat_val( struct colm_tree *tree );
 struct colm_tree *colm_get_left_repeat_next( struct colm_tree *tree );
 struct colm_tree *colm_get_left_repeat_val( struct colm_tree *tree );
 struct colm_location *colm_find_location( struct colm_program *prg, struct colm_tree *tree );
+struct colm_data *colm_tree_data( struct colm_program *prg, struct colm_tree *tree );
 
 static inline const colm_alph_t *colm_alph_from_cstr( const char *cstr ) { return (const colm_alph_t*)cstr; }
 static inline const char *colm_cstr_from_alph( const colm_alph_t *alph ) { return (const char*)alph; }
@@ -118,6 +128,11 @@ static inline const char *colm_cstr_from_alph( const colm_alph_t *alph ) { retur
 #define COLM_RN_LOC     0x02
 #define COLM_RN_BOTH    0x03
 
+/* JSON output options. Ignore tokens and token locations are left out unless
+ * asked for. */
+#define COLM_JSON_IGNORE 0x01
+#define COLM_JSON_LOC    0x02
+
 /*
  * Primary Interface.
  */
@@ -139,6 +154,30 @@ void colm_run_program2( struct colm_program *prg, int argc, const char **argv, c
 struct colm_tree *colm_run_func( struct colm_program *prg, int frame_id,
 		const char **params, int param_count );
 
+/* Return a program to the state it was in after colm_new_program, so it can
+ * be run again. Memory already allocated is kept for reuse. */
+void colm_reset_program( struct colm_program *prg );
+
+/* Save the values of the globals, typically after the root code has done its
+ * setup, and put them back after each input is handled. Trees are shared
+ * copy-on-write. Structs are not copied: those made since the snapshot are
+ * collected on restore, but changes to ones it reaches are kept. Snapshots
+ * are dropped by a reset. */
+struct colm_snapshot *colm_snapshot_program( struct colm_program *prg );
+void colm_restore_program( struct colm_program *prg, struct colm_snapshot *snap );
+void colm_delete_snapshot( struct colm_program *prg, struct colm_snapshot *snap );
+
+/* Parse input as it arrives. The parser is for a nonterminal the program
+ * parses; pass the ID from its export class. Each feed parses as far as the
+ * data allows and runs the semantic actions on the way. Finish sends the end
+ * of input and returns the tree, which belongs to the parser, or zero with the
+ * message in colm_error. */
+struct colm_push_parser *colm_push_parser_new( struct colm_program *prg, int lel_id );
+void colm_push_parser_feed( struct colm_program *prg, struct colm_push_parser *pp,
+		const char *data, long length );
+struct colm_tree *colm_push_parser_finish( struct colm_program *prg, struct colm_push_parser *pp );
+void colm_push_parser_delete( struct colm_program *prg, struct colm_push_parser *pp );
+
 /* Delete a colm program. Clears all memory. */
 int colm_delete_program( struct colm_program *prg );
 
@@ -146,6 +185,34 @@ int colm_delete_program( struct colm_program *prg );
 void *colm_get_reduce_ctx( struct colm_program *prg );
 void colm_set_reduce_ctx( struct colm_program *prg, void *ctx );
 void colm_set_reduce_clean( struct colm_program *prg, unsigned char reduce_clean );
+void colm_set_hash_cons( struct colm_program *prg, int hash_cons );
+void colm_set_lazy_ignore( struct colm_program *prg, int lazy_ignore );
+
+/* Run parser-based reductions on a second thread, fed the binary postfix
+ * form of each committed part of the tree. Needs a reducer generated with
+ * --reduce-thread. Reductions with actions that use tree references,
+ * locations, the lhs value, the pda_run or the prg stay on the parsing
+ * thread. */
+void colm_set_reduce_thread( struct colm_program *prg, int reduce_thread );
+
+/* Have reducers commit as soon as no alternative parse is pending, instead of
+ * only at commit points. Actions run while the input is being parsed and the
+ * parse trees stay as small as backtracking allows. */
+void colm_set_reduce_stream( struct colm_program *prg, int reduce_stream );
+
+/* Reserve the VM stack as one mapped region with a guard page below it,
+ * instead of a chain of malloc'd blocks. The default is on when configured
+ * with --enable-mmap-stack. Has no effect once the program has started
+ * running, or where mmap is not available. */
+void colm_set_stack_mmap( struct colm_program *prg, int stack_mmap );
+
+/* Size of the buffer used when printing to files. Zero writes every piece of
+ * output straight to stdio. */
+void colm_set_print_buffer( struct colm_program *prg, long size );
+
+/* Reverse code held by parsers: current and peak bytes, and bytes dropped at
+ * commit points. */
+void colm_rcode_stats( struct colm_program *prg, long *bytes, long *peak, long *released );
 
 const char *colm_error( struct colm_program *prg, int *length );
 
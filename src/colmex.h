@@ -33,7 +33,7 @@ struct ExportTree
 	colm_location *loc() { return colm_find_location( __prg, __tree ); }
 	std::string text_notrim() { return printTreeStr( __prg, __tree, false ); }
 	std::string text_ws() { return printTreeStr( __prg, __tree, false ); }
-	colm_data *data() { return __tree->tokdata; }
+	colm_data *data() { return colm_tree_data( __prg, __tree ); }
 	operator colm_tree *() { return __tree; }
 
 	colm_program *__prg;
@@ -33,6 +33,11 @@
 #include "tree.h"
 #include "pool.h"
 #include "internal.h"
+#include "postfix.h"
+
+#if defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
 
 void commit_clear_kid_list( program_t *prg, tree_t **sp, kid_t *kid )
 {
@@ -45,6 +50,32 @@ void commit_clear_kid_list( program_t *prg, tree_t **sp, kid_t *kid )
 	}
 }
 
+/* Drop the attributes, children and ignores of a committed tree. */
+void commit_clear_children( program_t *prg, tree_t **sp, tree_t *tree )
+{
+	kid_t *kid = tree->child, *next;
+	kid_t *block = tree->flags & AF_KID_BLOCK ? tree_attr( prg, tree ) : 0;
+	while ( kid != block ) {
+		colm_tree_downref( prg, sp, kid->tree );
+		next = kid->next;
+		kid_free( prg, kid );
+		kid = next;
+	}
+
+	if ( block != 0 ) {
+		long length = 0;
+		while ( kid != 0 ) {
+			colm_tree_downref( prg, sp, kid->tree );
+			kid = kid->next;
+			length += 1;
+		}
+		kid_block_free( prg, block, length );
+	}
+
+	tree->child = 0;
+	tree->flags &= ~( AF_LEFT_IGNORE | AF_RIGHT_IGNORE | AF_KID_BLOCK );
+}
+
 void commit_clear_parse_tree( program_t *prg, tree_t **sp,
 		struct pda_run *pda_run, parse_tree_t *pt )
 {
@@ -87,6 +118,306 @@ static int been_committed( parse_tree_t *parse_tree )
 	return parse_tree->flags & PF_COMMITTED;
 }
 
+#if defined(HAVE_PTHREAD_H)
+
+/*
+ * Threaded reduction. The parse trees and the runtime are not safe to share,
+ * so committed trees are written out in the binary postfix form and handed
+ * to the reducer thread in chunks, through a single producer, single consumer
+ * ring. A chunk is handed over when it is full, or at the end of a commit if
+ * the reducer thread has nothing else to do. The reducer thread keeps the
+ * stack of the postfix reader between chunks, which stands in for the
+ * committed parse trees left on the stack.
+ */
+
+#define REDUCE_RING_SIZE 64
+#define REDUCE_CHUNK_SIZE 65536
+
+struct reduce_chunk
+{
+	long len;
+	long size;
+	char data[];
+};
+
+struct reduce_pipe
+{
+	program_t *prg;
+	int reducer;
+
+	/* Guards the ring, head, tail and done. */
+	pthread_mutex_t mutex;
+
+	/* Signalled when a chunk is queued, or the parser is done. */
+	pthread_cond_t queued;
+
+	/* Signalled when a chunk has been reduced. */
+	pthread_cond_t reduced;
+
+	struct reduce_chunk *ring[REDUCE_RING_SIZE];
+
+	/* Chunks reduced, advanced by the reducer thread. */
+	unsigned long head;
+
+	/* Chunks queued, advanced by the parser. */
+	unsigned long tail;
+
+	int done;
+
+	/* The chunk being filled, owned by the parser. */
+	struct reduce_chunk *cur;
+
+	/* Owned by the reducer thread. */
+	void *stack;
+
+	pthread_t thread;
+};
+
+static void *reduce_pipe_thread( void *arg )
+{
+	struct reduce_pipe *rp = arg;
+	struct colm_postfix_reader reader;
+
+	pthread_mutex_lock( &rp->mutex );
+	while ( 1 ) {
+		while ( rp->head == rp->tail && !rp->done )
+			pthread_cond_wait( &rp->queued, &rp->mutex );
+
+		if ( rp->head == rp->tail )
+			break;
+
+		struct reduce_chunk *chunk = rp->ring[rp->head % REDUCE_RING_SIZE];
+		pthread_mutex_unlock( &rp->mutex );
+
+		colm_postfix_open_mem( &reader, chunk->data, chunk->len );
+		rp->prg->rtd->postfix_reduce( rp->prg, rp->reducer, &reader, &rp->stack );
+		colm_postfix_close( &reader );
+		free( chunk );
+
+		pthread_mutex_lock( &rp->mutex );
+		rp->head += 1;
+		pthread_cond_signal( &rp->reduced );
+	}
+	pthread_mutex_unlock( &rp->mutex );
+
+	return 0;
+}
+
+static void reduce_pipe_push( struct reduce_pipe *rp )
+{
+	if ( rp->cur == 0 || rp->cur->len == 0 )
+		return;
+
+	pthread_mutex_lock( &rp->mutex );
+	while ( rp->tail - rp->head == REDUCE_RING_SIZE )
+		pthread_cond_wait( &rp->reduced, &rp->mutex );
+
+	rp->ring[rp->tail % REDUCE_RING_SIZE] = rp->cur;
+	rp->tail += 1;
+	pthread_cond_signal( &rp->queued );
+	pthread_mutex_unlock( &rp->mutex );
+
+	rp->cur = 0;
+}
+
+/* At the end of a commit. Actions should not wait on a chunk filling up while
+ * the reducer thread sits idle. While it is busy, records collect into
+ * bigger chunks. */
+static void reduce_pipe_commit( struct reduce_pipe *rp )
+{
+	pthread_mutex_lock( &rp->mutex );
+	int idle = rp->head == rp->tail;
+	pthread_mutex_unlock( &rp->mutex );
+
+	if ( idle )
+		reduce_pipe_push( rp );
+}
+
+/* Room for a record of up to need bytes at the end of the current chunk. */
+static char *reduce_pipe_reserve( struct reduce_pipe *rp, long need )
+{
+	if ( rp->cur != 0 && rp->cur->len + need > rp->cur->size )
+		reduce_pipe_push( rp );
+
+	if ( rp->cur == 0 ) {
+		long size = need > REDUCE_CHUNK_SIZE ? need : REDUCE_CHUNK_SIZE;
+		rp->cur = malloc( sizeof(struct reduce_chunk) + size );
+		rp->cur->len = 0;
+		rp->cur->size = size;
+	}
+
+	return rp->cur->data + rp->cur->len;
+}
+
+static char *reduce_pipe_varint( char *p, unsigned long value )
+{
+	while ( value >= 0x80 ) {
+		*p++ = (char)( ( value & 0x7f ) | 0x80 );
+		value >>= 7;
+	}
+	*p++ = (char)value;
+	return p;
+}
+
+static void reduce_pipe_token( program_t *prg, struct reduce_pipe *rp, tree_t *tree )
+{
+	struct colm_data *tokdata = tree->tokdata;
+	struct colm_location *loc = colm_find_location( prg, tree );
+	long length = tokdata != 0 ? string_length( tokdata ) : 0;
+
+	char *p = reduce_pipe_reserve( rp, 1 + 5 * COLM_POSTFIX_VARINT_MAX + length );
+	*p++ = COLM_POSTFIX_TOKEN;
+	p = reduce_pipe_varint( p, tree->id );
+	p = reduce_pipe_varint( p, loc != 0 ? loc->line : 0 );
+	p = reduce_pipe_varint( p, loc != 0 ? loc->column : 0 );
+	p = reduce_pipe_varint( p, loc != 0 ? loc->byte : 0 );
+	p = reduce_pipe_varint( p, length );
+	if ( length > 0 ) {
+		memcpy( p, string_data( tokdata ), length );
+		p += length;
+	}
+	rp->cur->len = p - rp->cur->data;
+}
+
+static void reduce_pipe_reduce( struct reduce_pipe *rp, tree_t *tree, long children )
+{
+	char *p = reduce_pipe_reserve( rp, 1 + 3 * COLM_POSTFIX_VARINT_MAX );
+	*p++ = COLM_POSTFIX_REDUCE;
+	p = reduce_pipe_varint( p, tree->id );
+	p = reduce_pipe_varint( p, tree->prod_num );
+	p = reduce_pipe_varint( p, children );
+	rp->cur->len = p - rp->cur->data;
+}
+
+/* The walk of the generated commit_reduce_forward, writing a record where
+ * that runs an action. Committed children are already on the reducer's stack
+ * and are counted, not written. */
+static void reduce_pipe_write( program_t *prg, tree_t **root,
+		struct pda_run *pda_run, parse_tree_t *pt )
+{
+	struct reduce_pipe *rp = pda_run->reduce_pipe;
+	tree_t **sp = root;
+
+	parse_tree_t *lel = pt;
+	kid_t *kid = pt->shadow;
+
+recurse:
+
+	if ( lel->child != 0 ) {
+		vm_push_ptree( lel );
+		vm_push_kid( kid );
+
+		lel = lel->child;
+		kid = tree_child( prg, kid->tree );
+		while ( lel != 0 ) {
+			goto recurse;
+			resume:
+			lel = lel->next;
+			kid = kid->next;
+		}
+
+		kid = vm_pop_kid();
+		lel = vm_pop_ptree();
+	}
+
+	if ( !( lel->flags & PF_COMMITTED ) ) {
+		if ( kid->tree->id < prg->rtd->first_non_term_id )
+			reduce_pipe_token( prg, rp, kid->tree );
+		else {
+			long children = 0;
+			parse_tree_t *child;
+			for ( child = lel->child; child != 0; child = child->next )
+				children += 1;
+			reduce_pipe_reduce( rp, kid->tree, children );
+		}
+	}
+
+	commit_clear_parse_tree( prg, sp, pda_run, lel->child );
+	if ( prg->reduce_clean )
+		commit_clear_children( prg, sp, kid->tree );
+	lel->child = 0;
+
+	if ( sp != root )
+		goto resume;
+}
+
+/* Started on the first commit, if the program asks for it and the reducer
+ * was generated with postfix code. */
+static struct reduce_pipe *reduce_pipe_start( program_t *prg, struct pda_run *pda_run )
+{
+	if ( pda_run->reduce_pipe != 0 )
+		return pda_run->reduce_pipe;
+
+	if ( !prg->reduce_thread || prg->rtd->postfix_reduce == 0 ||
+			!prg->rtd->postfix_reduce( prg, pda_run->reducer, 0, 0 ) )
+		return 0;
+
+	struct reduce_pipe *rp = calloc( 1, sizeof(struct reduce_pipe) );
+	rp->prg = prg;
+	rp->reducer = pda_run->reducer;
+	pthread_mutex_init( &rp->mutex, 0 );
+	pthread_cond_init( &rp->queued, 0 );
+	pthread_cond_init( &rp->reduced, 0 );
+
+	if ( pthread_create( &rp->thread, 0, reduce_pipe_thread, rp ) != 0 ) {
+		/* Reduce in place from now on. */
+		pthread_cond_destroy( &rp->reduced );
+		pthread_cond_destroy( &rp->queued );
+		pthread_mutex_destroy( &rp->mutex );
+		free( rp );
+		prg->reduce_thread = 0;
+		return 0;
+	}
+
+	pda_run->reduce_pipe = rp;
+	return rp;
+}
+
+void commit_reduce_drain( program_t *prg, struct pda_run *pda_run )
+{
+	struct reduce_pipe *rp = pda_run->reduce_pipe;
+	if ( rp != 0 ) {
+		reduce_pipe_push( rp );
+
+		pthread_mutex_lock( &rp->mutex );
+		while ( rp->head != rp->tail )
+			pthread_cond_wait( &rp->reduced, &rp->mutex );
+		pthread_mutex_unlock( &rp->mutex );
+	}
+}
+
+void commit_reduce_stop( program_t *prg, struct pda_run *pda_run )
+{
+	struct reduce_pipe *rp = pda_run->reduce_pipe;
+	if ( rp != 0 ) {
+		reduce_pipe_push( rp );
+
+		pthread_mutex_lock( &rp->mutex );
+		rp->done = 1;
+		pthread_cond_signal( &rp->queued );
+		pthread_mutex_unlock( &rp->mutex );
+
+		pthread_join( rp->thread, 0 );
+
+		/* Nodes left on the stack were never reduced into anything. */
+		prg->rtd->postfix_reduce( prg, rp->reducer, 0, &rp->stack );
+
+		pthread_cond_destroy( &rp->reduced );
+		pthread_cond_destroy( &rp->queued );
+		pthread_mutex_destroy( &rp->mutex );
+		free( rp->cur );
+		free( rp );
+		pda_run->reduce_pipe = 0;
+	}
+}
+
+#else
+
+void commit_reduce_drain( program_t *prg, struct pda_run *pda_run ) {}
+void commit_reduce_stop( program_t *prg, struct pda_run *pda_run ) {}
+
+#endif
+
 void commit_reduce( program_t *prg, tree_t **root, struct pda_run *pda_run )
 {
 	tree_t **sp = root;
@@ -99,6 +430,24 @@ void commit_reduce( program_t *prg, tree_t **root, struct pda_run *pda_run )
 		pt = pt->next;
 	}
 
+#if defined(HAVE_PTHREAD_H)
+	struct reduce_pipe *rp = reduce_pipe_start( prg, pda_run );
+	if ( rp != 0 ) {
+		while ( sp != root ) {
+			pt = vm_pop_ptree();
+
+			reduce_pipe_write( prg, sp, pda_run, pt );
+			pt->child = 0;
+
+			pt->flags |= PF_COMMITTED;
+			pt = pt->next;
+		}
+
+		reduce_pipe_commit( rp );
+		return;
+	}
+#endif
+
 	while ( sp != root ) {
 		pt = vm_pop_ptree();
 
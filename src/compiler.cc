@@ -391,6 +391,7 @@ Compiler::Compiler( )
 	uniqueTypeInput(0),
 	uniqueTypeStream(0),
 	nextPatConsId(0),
+	nextPatSetId(0),
 	nextGenericId(1),
 	nextFuncId(0),
 	nextHostId(0),
@@ -1131,7 +1132,18 @@ void Compiler::writeHostCall()
 			*outStream <<
 				"			value_t p" << pos << " = vm_pop_value();\n";
 		}
-		
+
+		/* Host functions read string heads directly. Strings built by
+		 * concatenation must be flattened first. */
+		pos = 0;
+		for ( ParameterList::Iter p = *hc->paramList; p.lte(); p++, pos++ ) {
+			UniqueType *ut = hc->paramUTs[pos];
+			if ( ut->typeId == TYPE_TREE && ut->langEl == strLangEl ) {
+				*outStream <<
+					"			colm_tree_data( prg, (tree_t*)p" << pos << " );\n";
+			}
+		}
+
 		*outStream <<
 			"			rtn = " << hc->hostCall << "( prg, sp";
 
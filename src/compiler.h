@@ -783,6 +783,7 @@ struct Compiler
 	struct pda_tables *makePdaTables( PdaGraph *pdaGraph );
 
 	void fillInPatterns( program_t *prg );
+	void fillInPatternSets();
 	void makeRuntimeData();
 
 	/* Generate and write out the fsm. */
@@ -806,6 +807,9 @@ struct Compiler
 	void initMapFunctions( GenericType *gen );
 
 	void initVectorFunctions( GenericType *gen );
+	void initVectorFields( GenericType *gen );
+	void initHashMapFunctions( GenericType *gen );
+	void initHashMapFields( GenericType *gen );
 	void initParserField( GenericType *gen, const char *name,
 			int offset, TypeRef *typeRef );
 	void initParserFunctions( GenericType *gen );
@@ -1001,6 +1005,13 @@ struct Compiler
 	struct colm_sections *runtimeData;
 
 	int nextPatConsId;
+	int nextPatSetId;
+
+	/* Size of each pattern set, the members ahead of any production
+	 * comparison, and where its dispatch table starts in the code. */
+	Vector<long> patSetSize;
+	Vector<long> patSetLeading;
+	Vector<long> patSetTable;
 	int nextGenericId;
 
 	FunctionList functionList;
@@ -1079,6 +1090,10 @@ struct Compiler
 	void loadRefs( Reduction *reduction, Production *production,
 			const ReduceTextItemList &list, bool read );
 
+	bool threadReduce( Reduction *reduction );
+	bool threadReduce();
+	bool postfixReduce( Reduction *reduction );
+
 	void writePostfixReduce( Reduction *reduction );
 	void writeParseReduce( Reduction *reduction );
 
@@ -1090,7 +1105,6 @@ struct Compiler
 	void writeCommit();
 	void writeReduceStructs();
 	void writeReduceDispatchers();
-	void writeUnescape();
 
 	void writeLhsRef( Production *production, ReduceTextItem *i );
 	void writeRhsRef( Production *production, ReduceTextItem *i );
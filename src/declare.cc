@@ -384,10 +384,11 @@ void GenericType::declare( Compiler *pd, Namespace *nspace )
 {
 	elUt = elTr->resolveType( pd );
  
-	if ( typeId == GEN_MAP )
+	if ( typeId == GEN_MAP || typeId == GEN_HASHMAP )
 		keyUt = keyTr->resolveType( pd );
 	
-	if ( typeId == GEN_MAP || typeId == GEN_LIST )
+	if ( typeId == GEN_MAP || typeId == GEN_LIST ||
+			typeId == GEN_VECTOR || typeId == GEN_HASHMAP )
 		valueUt = valueTr->resolveType( pd );
 	
 	objDef = ObjectDef::cons( ObjectDef::BuiltinType, 
@@ -402,6 +403,14 @@ void GenericType::declare( Compiler *pd, Namespace *nspace )
 			pd->initListFunctions( this );
 			pd->initListFields( this );
 			break;
+		case GEN_VECTOR:
+			pd->initVectorFunctions( this );
+			pd->initVectorFields( this );
+			break;
+		case GEN_HASHMAP:
+			pd->initHashMapFunctions( this );
+			pd->initHashMapFields( this );
+			break;
 		case GEN_PARSER:
 			elUt->langEl->parserId = pd->nextParserId++;
 			pd->initParserFunctions( this );
@@ -959,6 +968,12 @@ void Compiler::declareStreamFields( )
 	initFunction( uniqueTypeVoid, streamObj, ObjectMethod::Call, "auto_trim",
 			IN_INPUT_AUTO_TRIM_WC, IN_INPUT_AUTO_TRIM_WC, uniqueTypeBool, false );
 
+	initFunction( uniqueTypeVoid, streamObj, ObjectMethod::Call, "json",
+			IN_PRINT_JSON_WC, IN_PRINT_JSON_WC, uniqueTypeAny, false );
+
+	initFunction( uniqueTypeVoid, streamObj, ObjectMethod::Call, "jsonac",
+			IN_PRINT_JSON_AC_WC, IN_PRINT_JSON_AC_WC, uniqueTypeAny, false );
+
 	declareStreamField( streamObj, 0 );
 }
 
@@ -1096,6 +1111,14 @@ void Compiler::declareGlobalFields()
 			FN_STR_ATOO,   FN_STR_ATOO, uniqueTypeStr, true, true );
 	method->useCallObj = false;
 
+	method = initFunction( uniqueTypeInt, rootNamespace, globalObjectDef, ObjectMethod::Call, "shl",
+			IN_SHL_INT, IN_SHL_INT, uniqueTypeInt, uniqueTypeInt, true );
+	method->useCallObj = false;
+
+	method = initFunction( uniqueTypeInt, rootNamespace, globalObjectDef, ObjectMethod::Call, "shr",
+			IN_SHR_INT, IN_SHR_INT, uniqueTypeInt, uniqueTypeInt, true );
+	method->useCallObj = false;
+
 	method = initFunction( uniqueTypeStr, rootNamespace, globalObjectDef, ObjectMethod::Call, "prefix",
 			FN_PREFIX, FN_PREFIX, uniqueTypeStr, uniqueTypeInt, true, true );
 	method->useCallObj = false;
@@ -1146,10 +1169,22 @@ void Compiler::declareGlobalFields()
 			IN_TREE_TO_STR_XML_AC, IN_TREE_TO_STR_XML_AC, uniqueTypeAny, true );
 	method->useCallObj = false;
 
+	method = initFunction( uniqueTypeStr, rootNamespace, globalObjectDef, ObjectMethod::Call, "json",
+			IN_TREE_TO_STR_JSON, IN_TREE_TO_STR_JSON, uniqueTypeAny, true );
+	method->useCallObj = false;
+
+	method = initFunction( uniqueTypeStr, rootNamespace, globalObjectDef, ObjectMethod::Call, "jsonac",
+			IN_TREE_TO_STR_JSON_AC, IN_TREE_TO_STR_JSON_AC, uniqueTypeAny, true );
+	method->useCallObj = false;
+
 	method = initFunction( uniqueTypeStr, rootNamespace, globalObjectDef, ObjectMethod::Call, "postfix",
 			IN_TREE_TO_STR_POSTFIX, IN_TREE_TO_STR_POSTFIX, uniqueTypeAny, true );
 	method->useCallObj = false;
 
+	method = initFunction( uniqueTypeStr, rootNamespace, globalObjectDef, ObjectMethod::Call, "postfix_bin",
+			IN_TREE_TO_STR_POSTFIX_BIN, IN_TREE_TO_STR_POSTFIX_BIN, uniqueTypeAny, true );
+	method->useCallObj = false;
+
 	addStdin();
 	addStdout();
 	addStderr();
@@ -1526,6 +1561,45 @@ void Compiler::initListFields( GenericType *gen )
 	initListElField( gen, "next", 1 );
 }
 
+void Compiler::initVectorFunctions( GenericType *gen )
+{
+	initFunction( uniqueTypeInt, gen->objDef, ObjectMethod::Call, "push", 
+			FN_VECTOR_PUSH_WV, FN_VECTOR_PUSH_WC, gen->valueUt, false, true, gen );
+
+	initFunction( gen->valueUt, gen->objDef, ObjectMethod::Call, "pop", 
+			FN_VECTOR_POP_WV, FN_VECTOR_POP_WC, false, true, gen );
+
+	initFunction( gen->valueUt, gen->objDef, ObjectMethod::Call, "get", 
+			FN_VECTOR_GET, FN_VECTOR_GET, uniqueTypeInt, true, true, gen );
+
+	initFunction( uniqueTypeInt, gen->objDef, ObjectMethod::Call, "set", 
+			FN_VECTOR_SET_WV, FN_VECTOR_SET_WC, uniqueTypeInt, gen->valueUt,
+			false, true, gen );
+}
+
+void Compiler::initVectorFields( GenericType *gen )
+{
+	addLengthField( gen->objDef, IN_VECTOR_LENGTH );
+}
+
+void Compiler::initHashMapFunctions( GenericType *gen )
+{
+	initFunction( gen->valueUt, gen->objDef, ObjectMethod::Call, "find", 
+			FN_HASHMAP_FIND, FN_HASHMAP_FIND, gen->keyUt, true, true, gen );
+
+	initFunction( uniqueTypeInt, gen->objDef, ObjectMethod::Call, "insert", 
+			FN_HASHMAP_INSERT_WV, FN_HASHMAP_INSERT_WC, gen->keyUt, gen->valueUt,
+			false, true, gen );
+
+	initFunction( gen->valueUt, gen->objDef, ObjectMethod::Call, "remove", 
+			FN_HASHMAP_REMOVE_WV, FN_HASHMAP_REMOVE_WC, gen->keyUt, false, true, gen );
+}
+
+void Compiler::initHashMapFields( GenericType *gen )
+{
+	addLengthField( gen->objDef, IN_HASHMAP_LENGTH );
+}
+
 void Compiler::initParserFunctions( GenericType *gen )
 {
 	initFunction( gen->elUt, gen->objDef, ObjectMethod::ParseFinish, "finish",
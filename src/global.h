@@ -64,6 +64,10 @@ extern bool printStatistics;
 
 extern int gblErrorCount;
 extern bool gblLibrary;
+extern bool gblHashCons;
+extern bool gblLazyIgnore;
+extern bool gblReduceThread;
+extern bool gblReduceStream;
 extern long gblActiveRealm;
 extern char machineMain[];
 extern const char *exportHeaderFn;
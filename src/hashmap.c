@@ -0,0 +1,201 @@
+/*
+ * Copyright 2026 Colm contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <colm/pdarun.h>
+#include <colm/program.h>
+#include <colm/struct.h>
+#include <colm/bytecode.h>
+
+/* Open addressing with linear probing and backward shift deletion, so there
+ * are no tombstones. Each slot caches the full hash of its key and keys are
+ * only compared when the hashes are equal. The table holds one reference to
+ * each tree key and value. */
+
+#define HASHMAP_MIN_ALLOC 16
+
+static word_t hashmap_hash( struct colm_program *prg, hashmap_t *map, value_t key )
+{
+	word_t h;
+	if ( map->generic_info->key_type == TYPE_TREE )
+		h = colm_hash_tree( prg, (tree_t*)key );
+	else {
+		h = (word_t)key;
+		h ^= h >> 33;
+		h *= (word_t)0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+	}
+
+	/* Zero marks an empty slot. */
+	return h != 0 ? h : 1;
+}
+
+static int hashmap_key_eq( struct colm_program *prg, hashmap_t *map,
+		value_t k1, value_t k2 )
+{
+	if ( map->generic_info->key_type == TYPE_TREE )
+		return colm_equal_tree( prg, (tree_t*)k1, (tree_t*)k2 );
+	return k1 == k2;
+}
+
+static long hashmap_lookup( struct colm_program *prg, hashmap_t *map,
+		value_t key, word_t hash )
+{
+	if ( map->alloc == 0 )
+		return -1;
+
+	long mask = map->alloc - 1;
+	long pos = hash & mask;
+	while ( map->slots[pos].hash != 0 ) {
+		if ( map->slots[pos].hash == hash &&
+				hashmap_key_eq( prg, map, map->slots[pos].key, key ) )
+			return pos;
+		pos = ( pos + 1 ) & mask;
+	}
+	return -1;
+}
+
+/* Place a slot whose key is known not to be present. */
+static void hashmap_place( hashmap_t *map, hashmap_slot_t *slot )
+{
+	long mask = map->alloc - 1;
+	long pos = slot->hash & mask;
+	while ( map->slots[pos].hash != 0 )
+		pos = ( pos + 1 ) & mask;
+	map->slots[pos] = *slot;
+}
+
+static void hashmap_grow( struct colm_program *prg, hashmap_t *map )
+{
+	/* Keep the load factor at or below three quarters. */
+	if ( ( map->len + 1 ) * 4 <= map->alloc * 3 )
+		return;
+
+	long old_alloc = map->alloc;
+	hashmap_slot_t *old_slots = map->slots;
+
+	map->alloc = old_alloc == 0 ? HASHMAP_MIN_ALLOC : old_alloc * 2;
+	map->slots = (hashmap_slot_t*) calloc( map->alloc, sizeof(hashmap_slot_t) );
+	prg->gc_allocated += sizeof(hashmap_slot_t) * ( map->alloc - old_alloc );
+
+	long i;
+	for ( i = 0; i < old_alloc; i++ ) {
+		if ( old_slots[i].hash != 0 )
+			hashmap_place( map, &old_slots[i] );
+	}
+
+	free( old_slots );
+}
+
+void colm_hashmap_destroy( struct colm_program *prg, tree_t **sp, struct colm_struct *s )
+{
+	hashmap_t *map = (hashmap_t*) s;
+	long i;
+	for ( i = 0; i < map->alloc; i++ ) {
+		if ( map->slots[i].hash == 0 )
+			continue;
+		if ( map->generic_info->key_type == TYPE_TREE )
+			colm_tree_downref( prg, sp, (tree_t*)map->slots[i].key );
+		if ( map->generic_info->value_type == TYPE_TREE )
+			colm_tree_downref( prg, sp, (tree_t*)map->slots[i].value );
+	}
+	free( map->slots );
+}
+
+hashmap_t *colm_hashmap_new( struct colm_program *prg )
+{
+	size_t memsize = sizeof(struct colm_hashmap);
+	struct colm_hashmap *map = (struct colm_hashmap*) malloc( memsize );
+	memset( map, 0, memsize );
+	colm_struct_add( prg, (struct colm_struct *)map, memsize );
+	map->id = prg->rtd->struct_inbuilt_id;
+	map->destructor = &colm_hashmap_destroy;
+	return map;
+}
+
+/* Returns true if the key was added, taking over the key and value. If the
+ * key is already present nothing is changed and the caller keeps them. */
+int colm_hashmap_insert( struct colm_program *prg, hashmap_t *map,
+		value_t key, value_t value )
+{
+	word_t hash = hashmap_hash( prg, map, key );
+	if ( hashmap_lookup( prg, map, key, hash ) >= 0 )
+		return 0;
+
+	hashmap_grow( prg, map );
+
+	hashmap_slot_t slot = { hash, key, value };
+	hashmap_place( map, &slot );
+	map->len += 1;
+	return 1;
+}
+
+value_t colm_hashmap_find( struct colm_program *prg, hashmap_t *map, value_t key )
+{
+	long pos = hashmap_lookup( prg, map, key, hashmap_hash( prg, map, key ) );
+	if ( pos < 0 )
+		return 0;
+
+	value_t value = map->slots[pos].value;
+	if ( map->generic_info->value_type == TYPE_TREE )
+		colm_tree_upref( prg, (tree_t*)value );
+	return value;
+}
+
+/* Detaches the entry, handing the stored key and value back to the caller.
+ * Following entries of the probe run are shifted back into the gap. */
+int colm_hashmap_remove( struct colm_program *prg, hashmap_t *map, value_t key,
+		value_t *rkey, value_t *rvalue )
+{
+	long pos = hashmap_lookup( prg, map, key, hashmap_hash( prg, map, key ) );
+	if ( pos < 0 )
+		return 0;
+
+	*rkey = map->slots[pos].key;
+	*rvalue = map->slots[pos].value;
+
+	long mask = map->alloc - 1;
+	long gap = pos;
+	long next = ( pos + 1 ) & mask;
+	while ( map->slots[next].hash != 0 ) {
+		long home = map->slots[next].hash & mask;
+
+		/* Move the entry back if its home is not in (gap, next]. */
+		if ( ( ( next - home ) & mask ) >= ( ( next - gap ) & mask ) ) {
+			map->slots[gap] = map->slots[next];
+			gap = next;
+		}
+		next = ( next + 1 ) & mask;
+	}
+
+	memset( &map->slots[gap], 0, sizeof(hashmap_slot_t) );
+	map->len -= 1;
+	return 1;
+}
+
+long colm_hashmap_length( hashmap_t *map )
+{
+	return map->len;
+}
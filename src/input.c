@@ -734,12 +734,33 @@ struct input_impl *colm_impl_new_generic( char *name )
 	return (struct input_impl*)ss;
 }
 
+/* Visit the stream impls that an input refers to but does not own. These
+ * belong to stream structs, which must stay alive as long as the input. */
+void colm_input_shared_streams( struct input_impl *impl,
+		void (*visit)( void *ctx, struct stream_impl *si ), void *ctx )
+{
+	struct input_impl_seq *is = (struct input_impl_seq*)impl;
+	if ( is == 0 || is->type != 'S' )
+		return;
+
+	struct seq_buf *buf;
+	for ( buf = is->queue.head; buf != 0; buf = buf->next ) {
+		if ( is_stream( buf ) && !buf->own_si )
+			visit( ctx, buf->si );
+	}
+
+	for ( buf = is->stash; buf != 0; buf = buf->next ) {
+		if ( is_stream( buf ) && !buf->own_si )
+			visit( ctx, buf->si );
+	}
+}
+
 input_t *colm_input_new_struct( program_t *prg )
 {
 	size_t memsize = sizeof(struct colm_input);
 	struct colm_input *input = (struct colm_input*) malloc( memsize );
 	memset( input, 0, memsize );
-	colm_struct_add( prg, (struct colm_struct *)input );
+	colm_struct_add( prg, (struct colm_struct *)input, memsize );
 	input->id = prg->rtd->struct_input_id;
 	input->destructor = &colm_input_destroy;
 	return input;
@@ -216,6 +216,8 @@ void stream_impl_push_line( struct stream_impl_data *ss, int ll );
 int stream_impl_pop_line( struct stream_impl_data *ss );
 
 struct input_impl *colm_impl_new_generic( char *name );
+void colm_input_shared_streams( struct input_impl *impl,
+		void (*visit)( void *ctx, struct stream_impl *si ), void *ctx );
 
 void update_position( struct stream_impl *input_stream, const char *data, long length );
 void undo_position( struct stream_impl *input_stream, const char *data, long length );
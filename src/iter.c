@@ -176,6 +176,68 @@ value_t colm_viter_deref_cur( program_t *prg, generic_iter_t *iter )
 	return value;
 }
 
+/* Vector iterators keep the position plus one in the ref, so that zero means
+ * the iteration has not started. */
+tree_t *colm_vector_iter_advance( program_t *prg, tree_t ***psp, generic_iter_t *iter )
+{
+	tree_t **sp = *psp;
+	assert( iter->yield_size == (vm_ssize() - iter->root_size) );
+
+	vector_t *vector = *((vector_t**)iter->root_ref.kid);
+	long pos = (long)iter->ref.kid + 1;
+	if ( pos > vector->len )
+		pos = 0;
+
+	iter->ref.kid = (kid_t*)pos;
+	iter->ref.next = 0;
+
+	sp = *psp;
+	iter->yield_size = vm_ssize() - iter->root_size;
+
+	return (iter->ref.kid ? prg->true_val : prg->false_val );
+}
+
+value_t colm_vector_iter_deref_cur( program_t *prg, generic_iter_t *iter )
+{
+	vector_t *vector = *((vector_t**)iter->root_ref.kid);
+	long pos = (long)iter->ref.kid;
+	return colm_vector_get( prg, vector, pos - 1 );
+}
+
+/* Hashmap iterators visit occupied slots in table order, keeping the slot
+ * index plus one in the ref. */
+tree_t *colm_hashmap_iter_advance( program_t *prg, tree_t ***psp, generic_iter_t *iter )
+{
+	tree_t **sp = *psp;
+	assert( iter->yield_size == (vm_ssize() - iter->root_size) );
+
+	hashmap_t *map = *((hashmap_t**)iter->root_ref.kid);
+	long pos = (long)iter->ref.kid;
+	while ( pos < map->alloc && map->slots[pos].hash == 0 )
+		pos += 1;
+
+	iter->ref.kid = (kid_t*)( pos < map->alloc ? pos + 1 : 0 );
+	iter->ref.next = 0;
+
+	sp = *psp;
+	iter->yield_size = vm_ssize() - iter->root_size;
+
+	return (iter->ref.kid ? prg->true_val : prg->false_val );
+}
+
+value_t colm_hashmap_iter_deref_cur( program_t *prg, generic_iter_t *iter )
+{
+	hashmap_t *map = *((hashmap_t**)iter->root_ref.kid);
+	long pos = (long)iter->ref.kid - 1;
+	if ( pos < 0 )
+		return 0;
+
+	value_t value = map->slots[pos].value;
+	if ( map->generic_info->value_type == TYPE_TREE )
+		colm_tree_upref( prg, (tree_t*)value );
+	return value;
+}
+
 void colm_init_tree_iter( tree_iter_t *tree_iter, tree_t **stack_root,
 		long arg_size, long root_size,
 		const ref_t *root_ref, int search_id )
@@ -367,7 +429,16 @@ rec_call:
 		return;
 	}
 	else {
-		child = tree_child_maybe_ignore( prg, iter->ref.kid->tree, with_ignore );
+		/* Summaries don't cover ignores, only prune grammar searches. */
+		child = 0;
+		if ( with_ignore || any_tree ||
+				colm_tree_may_contain( prg, iter->ref.kid->tree, iter->search_id ) )
+		{
+			/* Ignore lists attached lazily get their tokens built now. */
+			if ( with_ignore )
+				colm_ignore_materialize( prg, iter->ref.kid->tree );
+			child = tree_child_maybe_ignore( prg, iter->ref.kid->tree, with_ignore );
+		}
 		if ( child != 0 ) {
 			vm_contiguous( 2 );
 			vm_push_ref( iter->ref.next );
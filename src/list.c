@@ -204,7 +204,7 @@ list_t *colm_list_new( struct colm_program *prg )
 	size_t memsize = sizeof(struct colm_list);
 	struct colm_list *list = (struct colm_list*) malloc( memsize );
 	memset( list, 0, memsize );
-	colm_struct_add( prg, (struct colm_struct *)list );
+	colm_struct_add( prg, (struct colm_struct *)list, memsize );
 	list->id = prg->rtd->struct_inbuilt_id;
 	list->destructor = &colm_list_destroy;
 	return list;
@@ -472,6 +472,18 @@ struct LoadColm
 			expr = LangExpr::cons( mult.FSLASH().loc(), left, '/', right );
 			break;
 		}
+		case code_multiplicitive::Percent: {
+			LangExpr *right = walkCodeUnary( mult.code_unary() );
+			LangExpr *left = walkCodeMultiplicitive( mult._code_multiplicitive() );
+			expr = LangExpr::cons( mult.PERCENT().loc(), left, '%', right );
+			break;
+		}
+		case code_multiplicitive::Amp: {
+			LangExpr *right = walkCodeUnary( mult.code_unary() );
+			LangExpr *left = walkCodeMultiplicitive( mult._code_multiplicitive() );
+			expr = LangExpr::cons( mult.AMP().loc(), left, '&', right );
+			break;
+		}
 		case code_multiplicitive::Base: {
 			LangExpr *right = walkCodeUnary( mult.code_unary(), used );
 			expr = right;
@@ -946,6 +958,19 @@ struct LoadColm
 		return TypeRef::cons( typeRef.loc(), TypeRef::MapEl, 0, keyType, valType );
 	}
 
+	/* Generic types other than the keyword ones are named by an identifier,
+	 * which must be the expected name and unqualified. */
+	void checkGenericName( type_ref typeRef, const char *name )
+	{
+		String id = typeRef.id().data();
+		if ( typeRef.region_qual().prodName() != region_qual::Base ||
+				strcmp( id, name ) != 0 )
+		{
+			error( typeRef.id().loc() ) << "unknown generic type " <<
+					id << endp;
+		}
+	}
+
 	TypeRef *walkTypeRef( type_ref typeRef )
 	{
 		TypeRef *tr = 0;
@@ -989,6 +1014,20 @@ struct LoadColm
 		case type_ref::MapEl: {
 			tr = walkMapEl( typeRef );
 			break;
+		}
+		case type_ref::Generic: {
+			/* Not a keyword, so programs can still use the name. */
+			checkGenericName( typeRef, "vector" );
+			TypeRef *valType = walkTypeRef( typeRef._type_ref() );
+			tr = TypeRef::cons( typeRef.loc(), TypeRef::Vector, 0, valType, 0 );
+			break;
+		}
+		case type_ref::Generic2: {
+			checkGenericName( typeRef, "hashmap" );
+			TypeRef *keyType = walkTypeRef( typeRef.KeyType() );
+			TypeRef *valType = walkTypeRef( typeRef.ValType() );
+			tr = TypeRef::cons( typeRef.loc(), TypeRef::HashMap, 0, keyType, valType );
+			break;
 		}}
 		return tr;
 	}
@@ -2202,6 +2241,18 @@ struct LoadColm
 			expr = LangExpr::cons( additive.MINUS().loc(), left, '-', right );
 			break;
 		}
+		case code_additive::Bar: {
+			LangExpr *left = walkCodeAdditive( additive._code_additive() );
+			LangExpr *right = walkCodeMultiplicitive( additive.code_multiplicitive() );
+			expr = LangExpr::cons( additive.BAR().loc(), left, '|', right );
+			break;
+		}
+		case code_additive::Caret: {
+			LangExpr *left = walkCodeAdditive( additive._code_additive() );
+			LangExpr *right = walkCodeMultiplicitive( additive.code_multiplicitive() );
+			expr = LangExpr::cons( additive.CARET().loc(), left, '^', right );
+			break;
+		}
 		case code_additive::Base: {
 			expr = walkCodeMultiplicitive( additive.code_multiplicitive(), used );
 			break;
@@ -90,6 +90,10 @@ bool branchPointInfo = false;
 bool run = false;
 bool addUniqueEmptyProductions = false;
 bool gblLibrary = false;
+bool gblHashCons = false;
+bool gblLazyIgnore = false;
+bool gblReduceThread = false;
+bool gblReduceStream = false;
 long gblActiveRealm = 0;
 bool outputSpecifiedWithDashP = false;
 
@@ -206,6 +210,10 @@ void usage()
 "   -c                   compile only (don't produce binary)\n"
 "   -V                   print dot format (graphiz)\n"
 "   -d                   print verbose debug information\n"
+"   --hash-cons          share equal subtrees of constructed trees\n"
+"   --lazy-ignore        build single ignore tokens only when printed\n"
+"   --reduce-thread      also generate reductions that run on their own thread\n"
+"   --reduce-stream      reduce as soon as the parse cannot backtrack\n"
 #if DEBUG
 "   -D <tag>             print more information about <tag>\n"
 "                        (BYTECODE|PARSE|MATCH|COMPILE|POOL|PRINT|INPUT|SCAN\n"
@@ -584,6 +592,18 @@ void processArgs( int argc, const char **argv )
 					version();
 					exit(0);
 				}
+				else if ( strcasecmp(pc.parameterArg, "hash-cons") == 0 ) {
+					gblHashCons = true;
+				}
+				else if ( strcasecmp(pc.parameterArg, "lazy-ignore") == 0 ) {
+					gblLazyIgnore = true;
+				}
+				else if ( strcasecmp(pc.parameterArg, "reduce-thread") == 0 ) {
+					gblReduceThread = true;
+				}
+				else if ( strcasecmp(pc.parameterArg, "reduce-stream") == 0 ) {
+					gblReduceStream = true;
+				}
 				else {
 					error() << "--" << pc.parameterArg <<
 							" is an invalid argument" << endl;
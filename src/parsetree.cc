@@ -175,10 +175,12 @@ int CmpUniqueGeneric::compare( const UniqueGeneric &ut1, const UniqueGeneric &ut
 		case UniqueGeneric::List:
 		case UniqueGeneric::ListEl:
 		case UniqueGeneric::Parser:
+		case UniqueGeneric::Vector:
 			break;
 
 		case UniqueGeneric::Map:
 		case UniqueGeneric::MapEl:
+		case UniqueGeneric::HashMap:
 			if ( ut1.key < ut2.key )
 				return -1;
 			else if ( ut1.key > ut2.key )
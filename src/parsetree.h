@@ -1830,7 +1830,9 @@ struct Pattern
 		patRepId(0),
 		langEl(0),
 		pdaRun(0),
-		nextBindId(1)
+		nextBindId(1),
+		patSet(-1),
+		setIndex(0)
 	{}
 	
 	static Pattern *cons( const InputLoc &loc, Namespace *nspace,
@@ -1851,6 +1853,12 @@ struct Pattern
 	LangEl *langEl;
 	struct pda_run *pdaRun;
 	long nextBindId;
+
+	/* Consecutive matches of one subject are decided together. The pattern
+	 * set is -1 when the pattern stands alone. */
+	long patSet;
+	long setIndex;
+
 	Pattern *prev, *next;
 };
 
@@ -1948,7 +1956,7 @@ struct IterImpl
 {
 	enum Type { Tree, Child, RevChild, Repeat,
 			RevRepeat, User, ListEl, ListVal,
-			RevListVal, MapEl, MapVal, WithIgnore };
+			RevListVal, MapEl, MapVal, VectorVal, HashMapVal, WithIgnore };
 
 	IterImpl( Type type, Function *func );
 	IterImpl( Type type );
@@ -2156,6 +2164,8 @@ struct UniqueGeneric
 		ListEl,
 		Map,
 		MapEl,
+		Vector,
+		HashMap,
 		Parser
 	};
 
@@ -2216,6 +2226,8 @@ struct TypeRef
 		Map,
 		MapEl,
 		MapPtrs,
+		Vector,
+		HashMap,
 		Parser,
 		Ref
 	};
@@ -2403,6 +2415,8 @@ struct TypeRef
 	UniqueType *resolveTypeListEl( Compiler *pd );
 	UniqueType *resolveTypeMap( Compiler *pd );
 	UniqueType *resolveTypeMapEl( Compiler *pd );
+	UniqueType *resolveTypeVector( Compiler *pd );
+	UniqueType *resolveTypeHashMap( Compiler *pd );
 	UniqueType *resolveTypeParser( Compiler *pd );
 	UniqueType *resolveType( Compiler *pd );
 	UniqueType *resolveTypeRef( Compiler *pd );
@@ -2896,6 +2910,7 @@ struct LangVarRef
 			VarRefLookup &lookup, CallArgVect *args, bool temps ) const;
 
 	bool isFinishCall( VarRefLookup &lookup ) const;
+	bool sameRef( Compiler *pd, const LangVarRef *other ) const;
 
 	InputLoc loc;
 	Namespace *nspace;
@@ -3493,6 +3508,10 @@ struct LangStmt
 
 	void chooseDefaultIter( Compiler *pd, IterCall *iterCall ) const;
 	void compileWhile( Compiler *pd, CodeVect &code ) const;
+	void findPatternSet( Compiler *pd ) const;
+	Pattern *setPattern() const;
+	void compileMatchSet( Compiler *pd, CodeVect &code ) const;
+	void setMatchSetTarget( Compiler *pd, CodeVect &code ) const;
 	void compileForIterBody( Compiler *pd, CodeVect &code, UniqueType *iterUT ) const;
 	void compileForIter( Compiler *pd, CodeVect &code ) const;
 	void compile( Compiler *pd, CodeVect &code ) const;
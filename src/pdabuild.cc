@@ -1583,6 +1583,14 @@ void Compiler::makeRuntimeData()
 	runtimeData->pat_repl_nodes = 0;
 	runtimeData->num_pattern_nodes = 0;
 
+	for ( int i = 0; i < nextPatConsId; i++ )
+		runtimeData->pat_repl_info[i].set = -1;
+
+	runtimeData->pat_sets = 0;
+	runtimeData->num_pat_sets = 0;
+	runtimeData->pat_auto_nodes = 0;
+	runtimeData->num_pat_auto_nodes = 0;
+
 	
 	/*
 	 * generic_info
@@ -1746,6 +1754,7 @@ void Compiler::makeRuntimeData()
 	runtimeData->init_need = &internal_init_need;
 	runtimeData->reducer_need_tok = &internal_reducer_need_tok;
 	runtimeData->reducer_need_ign = &internal_reducer_need_ign;
+	runtimeData->postfix_reduce = 0;
 }
 
 /* Borrow alg->state for mapsTo. */
@@ -1923,6 +1932,9 @@ void Compiler::fillInPatterns( program_t *prg )
 		runtimeData->pat_repl_info[pat->patRepId].num_bindings = 
 				pat->pdaRun->bindings->length() - 1;
 
+		runtimeData->pat_repl_info[pat->patRepId].set = pat->patSet;
+		runtimeData->pat_repl_info[pat->patRepId].set_index = pat->setIndex;
+
 		/* Init the bind */
 		long bindId = 1;
 		fillNodes( prg, nextAvail, pat->pdaRun->bindings, bindId,
@@ -1949,6 +1961,128 @@ void Compiler::fillInPatterns( program_t *prg )
 	}
 
 	assert( nextAvail == count );
+
+	fillInPatternSets();
+}
+
+static void flattenPatternList( struct pat_cons_node *nodes, long pat,
+		Vector<pat_auto_node> &ops );
+
+/* Appends the tests of a pattern node in the order match_pattern makes
+ * them: the node, then its children unless it is a stop node. */
+static void flattenPatternNode( struct pat_cons_node *nodes, long pat,
+		Vector<pat_auto_node> &ops )
+{
+	pat_auto_node op;
+	memset( &op, 0, sizeof(pat_auto_node) );
+	op.id = nodes[pat].id;
+	op.data = nodes[pat].data;
+	op.length = nodes[pat].length;
+	op.stop = nodes[pat].stop;
+	ops.append( op );
+
+	if ( !nodes[pat].stop )
+		flattenPatternList( nodes, nodes[pat].child, ops );
+}
+
+/* A list of siblings, closed by a test for the end of the tree's list. */
+static void flattenPatternList( struct pat_cons_node *nodes, long pat,
+		Vector<pat_auto_node> &ops )
+{
+	for ( ; pat != -1; pat = nodes[pat].next )
+		flattenPatternNode( nodes, pat, ops );
+
+	pat_auto_node op;
+	memset( &op, 0, sizeof(pat_auto_node) );
+	op.end = 1;
+	ops.append( op );
+}
+
+static bool sameAutoOp( const pat_auto_node &n1, const pat_auto_node &n2 )
+{
+	if ( n1.end || n2.end )
+		return n1.end == n2.end;
+
+	return n1.id == n2.id && n1.stop == n2.stop &&
+			( n1.data == 0 ) == ( n2.data == 0 ) &&
+			n1.length == n2.length &&
+			( n1.data == 0 || memcmp( n1.data, n2.data, n1.length ) == 0 );
+}
+
+/* Merges the patterns of each set into a trie of tests. Members are added in
+ * set order, so siblings end up ordered by the lowest member below them. */
+void Compiler::fillInPatternSets()
+{
+	if ( nextPatSetId == 0 )
+		return;
+
+	struct pat_cons_node *nodes = runtimeData->pat_repl_nodes;
+	Vector<pat_auto_node> trie;
+
+	/* Patterns are listed in source order, which is also set order. */
+	Vector<Pattern*> *setMembers = new Vector<Pattern*>[nextPatSetId];
+	for ( PatList::Iter pat = patternList; pat.lte(); pat++ ) {
+		if ( pat->patSet >= 0 ) {
+			assert( pat->setIndex == setMembers[pat->patSet].length() );
+			setMembers[pat->patSet].append( pat );
+		}
+	}
+
+	runtimeData->pat_sets = new pat_set_info[nextPatSetId];
+	runtimeData->num_pat_sets = nextPatSetId;
+
+	for ( int set = 0; set < nextPatSetId; set++ ) {
+		long root = -1;
+
+		for ( long member = 0; member < setMembers[set].length(); member++ ) {
+			Pattern *pat = setMembers[set][member];
+
+			Vector<pat_auto_node> ops;
+			flattenPatternNode( nodes,
+					runtimeData->pat_repl_info[pat->patRepId].offset, ops );
+
+			long parent = -1;
+			for ( int i = 0; i < ops.length(); i++ ) {
+				long head = parent == -1 ? root : trie[parent].child;
+				long node = head, last = -1;
+				while ( node != -1 && !sameAutoOp( trie[node], ops[i] ) ) {
+					last = node;
+					node = trie[node].next;
+				}
+
+				if ( node == -1 ) {
+					node = trie.length();
+					ops[i].accept = -1;
+					ops[i].min_accept = member;
+					ops[i].child = -1;
+					ops[i].next = -1;
+					trie.append( ops[i] );
+
+					if ( last != -1 )
+						trie[last].next = node;
+					else if ( parent != -1 )
+						trie[parent].child = node;
+					else
+						root = node;
+				}
+
+				parent = node;
+			}
+
+			if ( trie[parent].accept == -1 )
+				trie[parent].accept = member;
+		}
+
+		runtimeData->pat_sets[set].root = root;
+		runtimeData->pat_sets[set].num_members = setMembers[set].length();
+	}
+
+	delete[] setMembers;
+
+	runtimeData->pat_auto_nodes = new pat_auto_node[trie.length()];
+	runtimeData->num_pat_auto_nodes = trie.length();
+	for ( int i = 0; i < trie.length(); i++ )
+		runtimeData->pat_auto_nodes[i] = trie[i];
 }
 
 
@@ -314,7 +314,9 @@ void PdaCodeGen::writeRuntimeData( colm_sections *runtimeData, struct pda_tables
 	out << "static struct pat_cons_info " << patReplInfo() << "[] = {\n";
 	for ( int i = 0; i < runtimeData->num_patterns; i++ ) {
 		out << "	{ " << runtimeData->pat_repl_info[i].offset << ", " <<
-				runtimeData->pat_repl_info[i].num_bindings << " },\n";
+				runtimeData->pat_repl_info[i].num_bindings << ", " <<
+				runtimeData->pat_repl_info[i].set << ", " <<
+				runtimeData->pat_repl_info[i].set_index << " },\n";
 	}
 	out << "};\n\n";
 
@@ -343,6 +345,41 @@ void PdaCodeGen::writeRuntimeData( colm_sections *runtimeData, struct pda_tables
 	}
 	out << "};\n\n";
 
+	/*
+	 * patSets
+	 */
+	if ( runtimeData->num_pat_sets > 0 ) {
+		out << "static struct pat_set_info " << patSets() << "[] = {\n";
+		for ( int i = 0; i < runtimeData->num_pat_sets; i++ ) {
+			out << "	{ " << runtimeData->pat_sets[i].root << ", " <<
+					runtimeData->pat_sets[i].num_members << " },\n";
+		}
+		out << "};\n\n";
+	}
+
+	/*
+	 * patAutoNodes
+	 */
+	if ( runtimeData->num_pat_auto_nodes > 0 ) {
+		out << "static struct pat_auto_node " << patAutoNodes() << "[] = {\n";
+		for ( int i = 0; i < runtimeData->num_pat_auto_nodes; i++ ) {
+			struct pat_auto_node &node = runtimeData->pat_auto_nodes[i];
+			out << "	{ " << node.id << ", ";
+			if ( node.data == 0 )
+				out << "0";
+			else {
+				out << '\"';
+				escapeLiteralString( out, node.data, node.length );
+				out << '\"';
+			}
+			out << ", " << node.length << ", " << (int)node.stop << ", " <<
+					(int)node.end << ", " << node.accept << ", " <<
+					node.min_accept << ", " << node.child << ", " <<
+					node.next << " },\n";
+		}
+		out << "};\n\n";
+	}
+
 	/*
 	 * functionInfo
 	 */
@@ -451,7 +488,9 @@ void PdaCodeGen::writeRuntimeData( colm_sections *runtimeData, struct pda_tables
 				"struct pda_run *pda_run, int id );\n"
 		"int " << objectName << "_reducer_need_ign( program_t *prg, "
 				"struct pda_run *pda_run );\n"
-		"void " << objectName << "_read_reduce( program_t *prg, int reducer, input_t *stream );\n"
+		"int " << objectName << "_read_reduce( program_t *prg, int reducer, stream_t *stream );\n"
+		"int " << objectName << "_postfix_reduce( program_t *prg, int reducer,\n"
+		"		struct colm_postfix_reader *reader, void **stack );\n"
 		"\n";
 
 	out <<
@@ -503,6 +542,12 @@ void PdaCodeGen::writeRuntimeData( colm_sections *runtimeData, struct pda_tables
 		"	" << patReplNodes() << ",\n"
 		"	" << runtimeData->num_pattern_nodes << ",\n"
 		"\n"
+		"	" << ( runtimeData->num_pat_sets > 0 ? patSets() : String( "0" ) ) << ",\n"
+		"	" << runtimeData->num_pat_sets << ",\n"
+		"\n"
+		"	" << ( runtimeData->num_pat_auto_nodes > 0 ? patAutoNodes() : String( "0" ) ) << ",\n"
+		"	" << runtimeData->num_pat_auto_nodes << ",\n"
+		"\n"
 		"	" << genericInfo() << ",\n"
 		"	" << runtimeData->num_generics << ",\n"
 		"\n"
@@ -550,6 +595,7 @@ void PdaCodeGen::writeRuntimeData( colm_sections *runtimeData, struct pda_tables
 		"	&" << objectName << "_reducer_need_tok,\n"
 		"	&" << objectName << "_reducer_need_ign,\n"
 		"	&" << objectName << "_read_reduce,\n" 
+		"	&" << objectName << "_postfix_reduce,\n"
 		"};\n"
 		"\n";
 }
@@ -77,6 +77,8 @@ struct PdaCodeGen
 	String objFieldInfo() { return PARSER() + "objFieldInfo"; }
 	String patReplInfo() { return PARSER() + "patReplInfo"; }
 	String patReplNodes() { return PARSER() + "patReplNodes"; }
+	String patSets() { return PARSER() + "patSets"; }
+	String patAutoNodes() { return PARSER() + "patAutoNodes"; }
 	String regionInfo() { return PARSER() + "regionInfo"; }
 	String genericInfo() { return PARSER() + "genericInfo"; }
 	String litdata() { return PARSER() + "litdata"; }
@@ -331,7 +331,6 @@ kid_t *make_token_with_data( program_t *prg, struct pda_run *pda_run,
 {
 	/* Make the token object. */
 	long object_length = prg->rtd->lel_info[id].object_length;
-	kid_t *attrs = alloc_attrs( prg, object_length );
 
 	kid_t *input = 0;
 	input = kid_allocate( prg );
@@ -344,7 +343,7 @@ kid_t *make_token_with_data( program_t *prg, struct pda_run *pda_run,
 	input->tree->tokdata = tokdata;
 
 	/* No children and ignores get added later. */
-	input->tree->child = attrs;
+	alloc_kid_block( prg, input->tree, object_length );
 
 	struct lang_el_info *lel_info = prg->rtd->lel_info;
 	if ( lel_info[id].num_capture_attr > 0 ) {
@@ -366,16 +365,7 @@ kid_t *make_token_with_data( program_t *prg, struct pda_run *pda_run,
 
 static void report_parse_error( program_t *prg, tree_t **sp, struct pda_run *pda_run )
 {
-	kid_t *kid = pda_run->bt_point;
-	head_t *deepest = 0;
-	while ( kid != 0 ) {
-		head_t *head = kid->tree->tokdata;
-		if ( head != 0 && head->location != 0 ) {
-			if ( deepest == 0 || head->location->byte > deepest->location->byte ) 
-				deepest = head;
-		}
-		kid = kid->next;
-	}
+	head_t *deepest = pda_run->bt_point != 0 ? pda_run->bt_point->tokdata : 0;
 
 	head_t *error_head = 0;
 
@@ -428,6 +418,32 @@ static void report_parse_error( program_t *prg, tree_t **sp, struct pda_run *pda
 	colm_tree_upref( prg, pda_run->parse_error_text );
 }
 
+/* In lazy ignore mode an ignore run of a single token from the input is
+ * attached without building a list for it. The token is relabelled as the
+ * list and rebuilt from its text only when printed or iterated over. */
+static tree_t *lazy_ignore_list( program_t *prg, parse_tree_t *accum )
+{
+	if ( !prg->lazy_ignore || accum == 0 || accum->next != 0 ||
+			( accum->flags & PF_ARTIFICIAL ) )
+		return 0;
+
+	kid_t *shadow = accum->shadow;
+	tree_t *tree = shadow->tree;
+	if ( tree->refs != 1 || tree->child != 0 || tree->tokdata == 0 )
+		return 0;
+
+	/* Detach the parse tree from the data tree. Attaching takes the
+	 * reference the shadow held. */
+	accum->shadow = 0;
+	kid_free( prg, shadow );
+	tree->refs = 0;
+
+	tree->prod_num = tree->id;
+	tree->id = LEL_ID_IGNORE;
+	tree->flags |= AF_LAZY_IGNORE;
+	return tree;
+}
+
 static void attach_right_ignore( program_t *prg, tree_t **sp,
 		struct pda_run *pda_run, parse_tree_t *parse_tree )
 {
@@ -463,6 +479,15 @@ static void attach_right_ignore( program_t *prg, tree_t **sp,
 			pda_run->accum_ignore = 0;
 		}
 
+		tree_t *lazy = lazy_ignore_list( prg, accum );
+		if ( lazy != 0 ) {
+			parse_tree->right_ignore = accum;
+			parse_tree->shadow->tree = push_right_ignore( prg,
+					parse_tree->shadow->tree, lazy );
+			parse_tree->flags |= PF_RIGHT_IL_ATTACHED;
+			return;
+		}
+
 		/* The data list needs to be extracted and reversed. The parse tree list
 		 * can remain in stack order. */
 		parse_tree_t *child = accum, *last = 0;
@@ -522,6 +547,15 @@ static void attach_left_ignore( program_t *prg, tree_t **sp,
 	parse_tree_t *accum = pda_run->accum_ignore;
 	pda_run->accum_ignore = 0;
 
+	tree_t *lazy = lazy_ignore_list( prg, accum );
+	if ( lazy != 0 ) {
+		parse_tree->left_ignore = accum;
+		parse_tree->shadow->tree = push_left_ignore( prg,
+				parse_tree->shadow->tree, lazy );
+		parse_tree->flags |= PF_LEFT_IL_ATTACHED;
+		return;
+	}
+
 	/* The data list needs to be extracted and reversed. The parse tree list
 	 * can remain in stack order. */
 	parse_tree_t *child = accum, *last = 0;
@@ -588,6 +622,18 @@ static void detach_right_ignore( program_t *prg, tree_t **sp,
 	if ( parse_tree->right_ignore != 0 ) {
 		assert( right_ignore != 0 );
 
+		if ( right_ignore->flags & AF_LAZY_IGNORE ) {
+			/* A single token. Our reference to the list goes to its shadow. */
+			parse_tree_t *ignore = parse_tree->right_ignore;
+			parse_tree->right_ignore = 0;
+
+			ignore->shadow = kid_allocate( prg );
+			ignore->shadow->tree = colm_lazy_ignore_token( prg, sp, right_ignore );
+
+			pda_run->accum_ignore = ignore;
+			return;
+		}
+
 		/* Transfer the trees to accumIgnore. */
 		parse_tree_t *ignore = parse_tree->right_ignore;
 		parse_tree->right_ignore = 0;
@@ -640,6 +686,18 @@ static void detach_left_ignore( program_t *prg, tree_t **sp,
 	if ( parse_tree->left_ignore != 0 ) {
 		assert( left_ignore != 0 );
 
+		if ( left_ignore->flags & AF_LAZY_IGNORE ) {
+			/* A single token. Our reference to the list goes to its shadow. */
+			parse_tree_t *ignore = parse_tree->left_ignore;
+			parse_tree->left_ignore = 0;
+
+			ignore->shadow = kid_allocate( prg );
+			ignore->shadow->tree = colm_lazy_ignore_token( prg, sp, left_ignore );
+
+			pda_run->accum_ignore = ignore;
+			return;
+		}
+
 		/* Transfer the trees to accumIgnore. */
 		parse_tree_t *ignore = parse_tree->left_ignore;
 		parse_tree->left_ignore = 0;
@@ -1033,24 +1091,50 @@ static void new_token( program_t *prg, struct pda_run *pda_run )
 	memset( pda_run->mark, 0, sizeof(pda_run->mark) );
 }
 
-static void push_bt_point( program_t *prg, struct pda_run *pda_run )
+static void push_token_list( struct pda_run *pda_run, kid_t *shadow )
+{
+	if ( pda_run->token_list_len == pda_run->token_list_alloc ) {
+		pda_run->token_list_alloc = pda_run->token_list_alloc == 0 ?
+				64 : pda_run->token_list_alloc * 2;
+		pda_run->token_list = (kid_t**) realloc( pda_run->token_list,
+				sizeof(kid_t*) * pda_run->token_list_alloc );
+	}
+
+	pda_run->token_list[pda_run->token_list_len++] = shadow;
+}
+
+/* Nothing below the commit point is backed over again. Keep only the last
+ * token, which error points are still taken from. */
+static void commit_token_list( struct pda_run *pda_run )
+{
+	if ( pda_run->token_list_len > 1 ) {
+		pda_run->token_list[0] = pda_run->token_list[pda_run->token_list_len - 1];
+		pda_run->token_list_len = 1;
+	}
+}
+
+/* Only the deepest error point is ever reported, so that is all we keep. On a
+ * tie the most recent wins. */
+static void push_bt_point( program_t *prg, tree_t **sp, struct pda_run *pda_run )
 {
 	tree_t *tree = 0;
 	if ( pda_run->accum_ignore != 0 ) 
 		tree = pda_run->accum_ignore->shadow->tree;
-	else if ( pda_run->token_list != 0 )
-		tree = pda_run->token_list->kid->tree;
+	else if ( pda_run->token_list_len > 0 )
+		tree = pda_run->token_list[pda_run->token_list_len - 1]->tree;
 
-	if ( tree != 0 ) {
+	if ( tree != 0 && tree->tokdata != 0 && tree->tokdata->location != 0 ) {
 		debug( prg, REALM_PARSE, "pushing bt point with location byte %d\n", 
-				( tree != 0 && tree->tokdata != 0 && tree->tokdata->location != 0 ) ? 
-				tree->tokdata->location->byte : 0 );
-
-		kid_t *kid = kid_allocate( prg );
-		kid->tree = tree;
-		colm_tree_upref( prg, tree );
-		kid->next = pda_run->bt_point;
-		pda_run->bt_point = kid;
+				tree->tokdata->location->byte );
+
+		tree_t *deepest = pda_run->bt_point;
+		if ( deepest == 0 || tree->tokdata->location->byte >=
+				deepest->tokdata->location->byte )
+		{
+			colm_tree_upref( prg, tree );
+			pda_run->bt_point = tree;
+			colm_tree_downref( prg, sp, deepest );
+		}
 	}
 }
 
@@ -1225,23 +1309,13 @@ void colm_pda_clear( program_t *prg, tree_t **sp, struct pda_run *pda_run )
 	clear_parse_tree( prg, sp, pda_run, pda_run->stack_top );
 	pda_run->stack_top = 0;
 
-	/* Traverse the token list downreffing. */
-	ref_t *ref = pda_run->token_list;
-	while ( ref != 0 ) {
-		ref_t *next = ref->next;
-		kid_free( prg, (kid_t*)ref );
-		ref = next;
-	}
+	/* The token list does not hold references. */
+	free( pda_run->token_list );
 	pda_run->token_list = 0;
+	pda_run->token_list_len = 0;
+	pda_run->token_list_alloc = 0;
 
-	/* Traverse the btPoint list downreffing */
-	kid_t *btp = pda_run->bt_point;
-	while ( btp != 0 ) {
-		kid_t *next = btp->next;
-		colm_tree_downref( prg, sp, btp->tree );
-		kid_free( prg, (kid_t*)btp );
-		btp = next;
-	}
+	colm_tree_downref( prg, sp, pda_run->bt_point );
 	pda_run->bt_point = 0;
 
 	/* Clear out any remaining ignores. */
@@ -1252,13 +1326,18 @@ void colm_pda_clear( program_t *prg, tree_t **sp, struct pda_run *pda_run )
 	clear_parse_tree( prg, sp, pda_run, pda_run->parse_input );
 	pda_run->parse_input = 0;
 
+	/* Reverse code still being collected holds references too. Close it off
+	 * so it is released with the rest. */
+	colm_make_reverse_code( pda_run );
 	colm_rcode_downref_all( prg, sp, &pda_run->reverse_code );
-	colm_rt_code_vect_empty( &pda_run->reverse_code );
+	colm_rcode_release( &pda_run->reverse_code );
 	colm_rt_code_vect_empty( &pda_run->rcode_collect );
 
 	colm_tree_downref( prg, sp, pda_run->parse_error_text );
 
 	if ( pda_run->reducer ) {
+		commit_reduce_stop( prg, pda_run );
+
 		long local_lost = pool_alloc_num_lost( &pda_run->local_pool );
 
 		if ( local_lost )
@@ -1318,7 +1397,7 @@ void colm_pda_init( program_t *prg, struct pda_run *pda_run, struct pda_tables *
 
 	prg->rtd->init_bindings( pda_run );
 
-	init_rt_code_vect( &pda_run->reverse_code );
+	colm_rcode_init( &pda_run->reverse_code, &prg->rcode_stats );
 	init_rt_code_vect( &pda_run->rcode_collect );
 
 	pda_run->context = context;
@@ -1354,6 +1433,29 @@ static long stack_top_target( program_t *prg, struct pda_run *pda_run )
 	return state;
 }
 
+/* Retries held by a list of trees that are not on the stack: a retry of the
+ * tree itself, or of the next scanner region, as counted by set_region. */
+static int pending_retries( struct pda_run *pda_run, parse_tree_t *pt )
+{
+	int count = 0;
+	for ( ; pt != 0; pt = pt->next ) {
+		if ( pt->retry_lower != 0 || pt->retry_upper != 0 )
+			count += 1;
+		if ( pt->retry_region > 0 &&
+				pda_run->pda_tables->token_regions[pt->retry_region+1] != 0 )
+			count += 1;
+	}
+	return count;
+}
+
+/* A streaming reducer commits whenever there is nothing left to backtrack
+ * to. Reductions then run as the parse goes and the trees under them are
+ * freed straight away, rather than at the grammar's commit points. */
+static int stream_commit( program_t *prg, struct pda_run *pda_run )
+{
+	return pda_run->reducer && prg->reduce_stream && pda_run->num_retry == 0;
+}
+
 /*
  * shift:         retry goes into lower of shifted node.
  * reduce:        retry goes into upper of reduced node.
@@ -1401,7 +1503,7 @@ again:
 			pda_run->lel->id > pda_run->pda_tables->keys[(pda_run->cur_state<<1)+1] )
 	{
 		debug( prg, REALM_PARSE, "parse error, no transition 1\n" );
-		push_bt_point( prg, pda_run );
+		push_bt_point( prg, sp, pda_run );
 		goto parse_error;
 	}
 
@@ -1411,14 +1513,14 @@ again:
 	owner = pda_run->pda_tables->owners[ind_pos];
 	if ( owner != pda_run->cur_state ) {
 		debug( prg, REALM_PARSE, "parse error, no transition 2\n" );
-		push_bt_point( prg, pda_run );
+		push_bt_point( prg, sp, pda_run );
 		goto parse_error;
 	}
 
 	pos = pda_run->pda_tables->indices[ind_pos];
 	if ( pos < 0 ) {
 		debug( prg, REALM_PARSE, "parse error, no transition 3\n" );
-		push_bt_point( prg, pda_run );
+		push_bt_point( prg, sp, pda_run );
 		goto parse_error;
 	}
 
@@ -1457,11 +1559,7 @@ again:
 		if ( pda_run->lel->id < prg->rtd->first_non_term_id ) {
 			attach_left_ignore( prg, sp, pda_run, pda_run->lel );
 
-			ref_t *ref = (ref_t*)kid_allocate( prg );
-			ref->kid = pda_run->lel->shadow;
-			//colm_tree_upref( prg, pdaRun->tree );
-			ref->next = pda_run->token_list;
-			pda_run->token_list = ref;
+			push_token_list( pda_run, pda_run->lel->shadow );
 		}
 
 		if ( action[1] == 0 )
@@ -1481,9 +1579,23 @@ again:
 	 * Commit
 	 */
 
-	if ( pda_run->pda_tables->commit_len[pos] != 0 ) {
+	if ( pda_run->pda_tables->commit_len[pos] != 0 || stream_commit( prg, pda_run ) ) {
 		debug( prg, REALM_PARSE, "commit point\n" );
 		pda_run->commit_shift_count = pda_run->shift_count;
+		commit_token_list( pda_run );
+
+		/* Backtracking stops here, so none of the reverse code built so far
+		 * can run again. Drop it unless a block is waiting for its tree. */
+		if ( pda_run->rc_block_count == 0 && pda_run->rcode_collect.tab_len == 0 ) {
+			long bytes = prg->rcode_stats.bytes;
+			colm_rcode_downref_all( prg, sp, &pda_run->reverse_code );
+			prg->rcode_stats.released += bytes - prg->rcode_stats.bytes;
+		}
+
+		/* Retries on the stack are now out of reach. Only those held by input
+		 * that is still waiting to be shifted are left. */
+		pda_run->num_retry = pending_retries( pda_run, pda_run->parse_input ) +
+				pending_retries( pda_run, pda_run->accum_ignore );
 
 		/* Not in a reverting context and the parser result is not used. */
 		if ( pda_run->reducer )
@@ -1564,6 +1676,7 @@ again:
 
 		pda_run->red_lel->child = child;
 		pda_run->red_lel->shadow->tree->child = kid_list_concat( attrs, data_child );
+		colm_tree_summarize( prg, pda_run->red_lel->shadow->tree );
 
 		debug( prg, REALM_PARSE, "reduced: %s rhsLen %d\n",
 				prg->rtd->prod_info[pda_run->reduction].name, rhs_len );
@@ -1644,7 +1757,7 @@ again:
 			pda_run->red_lel->next = pda_run->stack_top;
 			pda_run->stack_top = pda_run->red_lel;
 			/* FIXME: What is the right argument here? */
-			push_bt_point( prg, pda_run );
+			push_bt_point( prg, sp, pda_run );
 			goto parse_error;
 		}
 
@@ -1880,9 +1993,7 @@ parse_error:
 				pda_run->parse_input = pda_run->undo_lel;
 
 				/* Pop from the token list. */
-				ref_t *ref = pda_run->token_list;
-				pda_run->token_list = ref->next;
-				kid_free( prg, (kid_t*)ref );
+				pda_run->token_list_len -= 1;
 
 				assert( pda_run->accum_ignore == 0 );
 				detach_left_ignore( prg, sp, pda_run, pda_run->parse_input );
@@ -2015,7 +2126,7 @@ long colm_parse_loop( program_t *prg, tree_t **sp, struct pda_run *pda_run,
 				debug( prg, REALM_PARSE, "invoking parse error from the scanner\n" );
 
 				/* Fall through to send null (error). */
-				push_bt_point( prg, pda_run );
+				push_bt_point( prg, sp, pda_run );
 			}
 #if 0
 			else {
@@ -2024,7 +2135,7 @@ long colm_parse_loop( program_t *prg, tree_t **sp, struct pda_run *pda_run,
 				/* There are no alternative scanning regions to try, nor are
 				 * there any alternatives stored in the current parse tree. No
 				 * choice but to end the parse. */
-				push_bt_point( prg, pda_run );
+				push_bt_point( prg, sp, pda_run );
 
 				report_parse_error( prg, sp, pda_run );
 				pda_run->parse_error = 1;
@@ -2260,8 +2371,11 @@ long colm_parse_undo_frag( program_t *prg, tree_t **sp, struct pda_run *pda_run,
 void colm_parse_reduce_commit( program_t *prg, tree_t **sp,
 		struct pda_run *pda_run )
 {
-	/* Flush out anything not committed. */
-	if ( pda_run->reducer )
+	/* Flush out anything not committed, and wait for a reducer thread to
+	 * catch up so the results are visible when this returns. */
+	if ( pda_run->reducer ) {
 		commit_reduce( prg, sp, pda_run );
+		commit_reduce_drain( prg, pda_run );
+	}
 }
 
@@ -33,6 +33,8 @@ extern "C" {
 #endif
 
 struct colm_program;
+struct colm_postfix_reader;
+struct reduce_pipe;
 
 #define MARK_SLOTS 32
 
@@ -81,8 +83,44 @@ struct rt_code_vect
 	code_t *data;
 	long tab_len;
 	long alloc_len;
+};
+
+#define RCODE_CHUNK_SIZE 4096
+
+/* A piece of the reverse code stack. Blocks never straddle chunks, so a
+ * popped block can be executed where it lies. */
+struct rcode_chunk
+{
+	struct rcode_chunk *prev;
+	long len;
+	long alloc;
+
+	/* Must be at the end. Grown for blocks that do not fit the default. */
+	code_t data[RCODE_CHUNK_SIZE];
+};
+
+/* Reverse code held by all parsers of a program. */
+struct rcode_stats
+{
+	long bytes;
+	long peak;
+	long chunks;
 
-	/* FIXME: leak when freed. */
+	/* Dropped at commit points, where it could no longer be reached. */
+	long released;
+};
+
+/* Reverse code for everything parsed since the last commit point. A stack of
+ * blocks, each followed by its length. */
+struct rcode_arena
+{
+	struct rcode_chunk *top;
+
+	/* The last chunk emptied by a pop, kept for reuse. Still holds the block
+	 * that was popped from it. */
+	struct rcode_chunk *spare;
+
+	struct rcode_stats *stats;
 };
 
 void list_add_after( list_t *list, list_el_t *prev_el, list_el_t *new_el );
@@ -112,6 +150,10 @@ struct pat_cons_info
 {
 	long offset;
 	long num_bindings;
+
+	/* Pattern set this match belongs to, or -1. */
+	long set;
+	long set_index;
 };
 
 struct pat_cons_node
@@ -130,6 +172,32 @@ struct pat_cons_node
 	unsigned char stop;
 };
 
+/* The patterns of a set, flattened in preorder and merged on common
+ * prefixes. A node either tests a tree or, when end is set, checks that a
+ * child list is exhausted. Siblings are alternatives, ordered by the lowest
+ * set index reachable below them. */
+struct pat_auto_node
+{
+	long id;
+	const char *data;
+	long length;
+	unsigned char stop;
+	unsigned char end;
+
+	/* Set index of a pattern that is complete here, or -1. */
+	long accept;
+	long min_accept;
+
+	long child;
+	long next;
+};
+
+struct pat_set_info
+{
+	long root;
+	long num_members;
+};
+
 /* FIXME: should have a descriptor for object types to give the length. */
 
 struct lang_el_info
@@ -287,7 +355,13 @@ struct pda_run
 	 */
 	int num_retry;
 	parse_tree_t *stack_top;
-	ref_t *token_list;
+
+	/* Shadows of the tokens shifted since the last commit point, most recent
+	 * last. Backing up pops them. */
+	kid_t **token_list;
+	long token_list_len;
+	long token_list_alloc;
+
 	int pda_cs;
 	int next_region_ind;
 
@@ -296,14 +370,15 @@ struct pda_run
 
 	/* Reused. */
 	struct rt_code_vect rcode_collect;
-	struct rt_code_vect reverse_code;
+	struct rcode_arena reverse_code;
 
 	int stop_parsing;
 	long stop_target;
 
 	parse_tree_t *accum_ignore;
 
-	kid_t *bt_point;
+	/* The deepest token a parse error was found at, for reporting. */
+	tree_t *bt_point;
 
 	struct bindings *bindings;
 
@@ -368,6 +443,9 @@ struct pda_run
 	struct pool_alloc *parse_tree_pool;
 	struct pool_alloc local_pool;
 
+	/* Feeds a reducer running on another thread, if enabled. */
+	struct reduce_pipe *reduce_pipe;
+
 	/* Disregard any alternate parse paths, just go right to failure. */
 	int fail_parsing;
 };
@@ -386,6 +464,13 @@ void colm_rt_code_vect_remove( struct rt_code_vect *vect, long pos, long len );
 
 void init_rt_code_vect( struct rt_code_vect *code_vect );
 
+void colm_rcode_init( struct rcode_arena *arena, struct rcode_stats *stats );
+void colm_rcode_reserve( struct rcode_arena *arena, long len );
+void colm_rcode_append( struct rcode_arena *arena, const code_t *data, long len );
+void colm_rcode_append_word( struct rcode_arena *arena, word_t word );
+void colm_rcode_drop( struct rcode_arena *arena, long len );
+void colm_rcode_release( struct rcode_arena *arena );
+
 inline static void append_code_val( struct rt_code_vect *vect, const code_t val );
 inline static void append_code_vect( struct rt_code_vect *vect, const code_t *val, long len );
 inline static void append_half( struct rt_code_vect *vect, half_t half );
@@ -453,10 +538,13 @@ long colm_parse_undo_frag( struct colm_program *prg, tree_t **sp, struct pda_run
 		input_t *input, long entry, long steps );
 
 void commit_clear_kid_list( program_t *prg, tree_t **sp, kid_t *kid );
+void commit_clear_children( program_t *prg, tree_t **sp, tree_t *tree );
 void commit_clear_parse_tree( program_t *prg, tree_t **sp,
 		struct pda_run *pda_run, parse_tree_t *pt );
 void commit_reduce( program_t *prg, tree_t **root,
 		struct pda_run *pda_run );
+void commit_reduce_drain( program_t *prg, struct pda_run *pda_run );
+void commit_reduce_stop( program_t *prg, struct pda_run *pda_run );
 
 tree_t *get_parsed_root( struct pda_run *pda_run, int stop );
 
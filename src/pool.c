@@ -151,6 +151,42 @@ long kid_num_lost( program_t *prg )
 	return pool_alloc_num_lost( &prg->kid_pool );
 }
 
+/*
+ * Contiguous kid blocks. Size classes of 1 to KID_BLOCK_MAX kids.
+ */
+
+kid_t *kid_block_allocate( program_t *prg, long length )
+{
+	assert( length > 0 && length <= KID_BLOCK_MAX );
+	kid_t *block = (kid_t*) pool_alloc_allocate( &prg->kid_block_pool[length-1] );
+
+	long i;
+	for ( i = 0; i < length - 1; i++ )
+		block[i].next = &block[i+1];
+	return block;
+}
+
+void kid_block_free( program_t *prg, kid_t *block, long length )
+{
+	assert( length > 0 && length <= KID_BLOCK_MAX );
+	pool_alloc_free( &prg->kid_block_pool[length-1], block );
+}
+
+void kid_block_clear( program_t *prg )
+{
+	long i;
+	for ( i = 0; i < KID_BLOCK_MAX; i++ )
+		pool_alloc_clear( &prg->kid_block_pool[i] );
+}
+
+long kid_block_num_lost( program_t *prg )
+{
+	long i, lost = 0;
+	for ( i = 0; i < KID_BLOCK_MAX; i++ )
+		lost += pool_alloc_num_lost( &prg->kid_block_pool[i] );
+	return lost;
+}
+
 /* 
  * tree_t
  */
@@ -41,6 +41,11 @@ void kid_free( program_t *prg, kid_t *el );
 void kid_clear( program_t *prg );
 long kid_num_lost( program_t *prg );
 
+kid_t *kid_block_allocate( program_t *prg, long length );
+void kid_block_free( program_t *prg, kid_t *block, long length );
+void kid_block_clear( program_t *prg );
+long kid_block_num_lost( program_t *prg );
+
 tree_t *tree_allocate( program_t *prg );
 void tree_free( program_t *prg, tree_t *el );
 void tree_clear( program_t *prg );
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2026 Colm contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "config.h"
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <colm/pdarun.h>
+#include <colm/program.h>
+#include <colm/postfix.h>
+
+void colm_postfix_open_mem( struct colm_postfix_reader *reader,
+		const char *data, long length )
+{
+	memset( reader, 0, sizeof(struct colm_postfix_reader) );
+	reader->p = (const unsigned char*)data;
+	reader->pe = (const unsigned char*)data + length;
+}
+
+#if defined(HAVE_SYS_MMAN_H)
+static int postfix_map_file( struct colm_postfix_reader *reader, FILE *file )
+{
+	struct stat st;
+	int fd = fileno( file );
+	if ( fd < 0 || fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size == 0 )
+		return 0;
+
+	long offset = ftell( file );
+	if ( offset < 0 || offset > st.st_size )
+		return 0;
+
+	void *map = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if ( map == MAP_FAILED )
+		return 0;
+
+	reader->map = map;
+	reader->map_len = st.st_size;
+	reader->p = (const unsigned char*)map + offset;
+	reader->pe = (const unsigned char*)map + st.st_size;
+	return 1;
+}
+#endif
+
+/* Anything else is pulled through the stream into one buffer. */
+static void postfix_read_stream( struct colm_postfix_reader *reader,
+		struct colm_program *prg, struct stream_impl_data *si )
+{
+	long len = 0, alloc = FSM_BUFSIZE;
+	char *buf = malloc( alloc );
+
+	struct run_buf *rb;
+	for ( rb = si->queue.head; rb != 0; rb = rb->next ) {
+		long avail = rb->length - rb->offset;
+		if ( len + avail > alloc ) {
+			alloc = ( len + avail ) * 2;
+			buf = realloc( buf, alloc );
+		}
+		memcpy( buf + len, rb->data + rb->offset, avail );
+		len += avail;
+	}
+
+	while ( 1 ) {
+		if ( alloc - len < FSM_BUFSIZE ) {
+			alloc *= 2;
+			buf = realloc( buf, alloc );
+		}
+
+		int received = si->funcs->get_data_source( prg,
+				(struct stream_impl*)si, (alph_t*)buf + len, FSM_BUFSIZE );
+		if ( received == 0 )
+			break;
+		len += received;
+	}
+
+	reader->buf = buf;
+	reader->p = (const unsigned char*)buf;
+	reader->pe = (const unsigned char*)buf + len;
+}
+
+int colm_postfix_open_stream( struct colm_postfix_reader *reader,
+		struct colm_program *prg, struct colm_stream *stream )
+{
+	struct stream_impl_data *si = (struct stream_impl_data*)stream->impl;
+
+	memset( reader, 0, sizeof(struct colm_postfix_reader) );
+
+	if ( si->queue.head == 0 && si->file == 0 && si->data != 0 ) {
+		reader->p = (const unsigned char*)si->data + si->offset;
+		reader->pe = (const unsigned char*)si->data + si->dlen;
+	}
+#if defined(HAVE_SYS_MMAN_H)
+	else if ( si->queue.head == 0 && si->file != 0 && postfix_map_file( reader, si->file ) ) {
+	}
+#endif
+	else {
+		postfix_read_stream( reader, prg, si );
+	}
+
+	if ( reader->pe - reader->p < COLM_POSTFIX_MAGIC_LEN ||
+			memcmp( reader->p, COLM_POSTFIX_MAGIC, COLM_POSTFIX_MAGIC_LEN ) != 0 )
+	{
+		colm_postfix_close( reader );
+		return 0;
+	}
+
+	reader->p += COLM_POSTFIX_MAGIC_LEN;
+	return 1;
+}
+
+static int postfix_varint( struct colm_postfix_reader *reader, long *value )
+{
+	unsigned long v = 0;
+	int shift = 0;
+	while ( reader->p < reader->pe && shift < 7 * COLM_POSTFIX_VARINT_MAX ) {
+		unsigned char c = *reader->p++;
+
+		/* Values must fit in a long. */
+		if ( shift == 63 && ( c & 0x7f ) != 0 )
+			return 0;
+
+		v |= (unsigned long)( c & 0x7f ) << shift;
+		if ( ( c & 0x80 ) == 0 ) {
+			*value = (long)v;
+			return 1;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+int colm_postfix_next( struct colm_postfix_reader *reader,
+		struct colm_postfix_rec *rec )
+{
+	if ( reader->p == reader->pe )
+		return 0;
+
+	rec->type = *reader->p++;
+	switch ( rec->type ) {
+		case COLM_POSTFIX_TOKEN:
+			if ( !postfix_varint( reader, &rec->id ) ||
+					!postfix_varint( reader, &rec->line ) ||
+					!postfix_varint( reader, &rec->column ) ||
+					!postfix_varint( reader, &rec->byte ) ||
+					!postfix_varint( reader, &rec->length ) ||
+					rec->length > reader->pe - reader->p )
+				return -1;
+
+			rec->data = (const char*)reader->p;
+			reader->p += rec->length;
+			return 1;
+
+		case COLM_POSTFIX_REDUCE:
+			if ( !postfix_varint( reader, &rec->id ) ||
+					!postfix_varint( reader, &rec->prod_num ) ||
+					!postfix_varint( reader, &rec->children ) )
+				return -1;
+			return 1;
+
+		case COLM_POSTFIX_PTR:
+		case COLM_POSTFIX_STR:
+			return 1;
+	}
+
+	return -1;
+}
+
+void colm_postfix_close( struct colm_postfix_reader *reader )
+{
+#if defined(HAVE_SYS_MMAN_H)
+	if ( reader->map != 0 )
+		munmap( reader->map, reader->map_len );
+#endif
+	free( reader->buf );
+	memset( reader, 0, sizeof(struct colm_postfix_reader) );
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2026 Colm contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _COLM_POSTFIX_H
+#define _COLM_POSTFIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct colm_program;
+struct colm_stream;
+struct read_reduce_node;
+
+/*
+ * Binary postfix form of a tree, written by the postfix_bin builtin. A magic
+ * number, then one record per token and per reduction, children before
+ * parents. Numbers are unsigned varints, seven bits per byte, low bits first,
+ * and must fit in a long.
+ *
+ *   't' id line column byte length data[length]
+ *   'r' id prod_num children
+ *   'p' (pointer), 's' (string)
+ */
+
+#define COLM_POSTFIX_MAGIC     "\177cpf"
+#define COLM_POSTFIX_MAGIC_LEN 4
+
+#define COLM_POSTFIX_TOKEN     't'
+#define COLM_POSTFIX_REDUCE    'r'
+#define COLM_POSTFIX_PTR       'p'
+#define COLM_POSTFIX_STR       's'
+
+#define COLM_POSTFIX_VARINT_MAX 10
+
+struct colm_postfix_rec
+{
+	char type;
+	long id;
+	long prod_num;
+	long children;
+
+	long line;
+	long column;
+	long byte;
+
+	/* Points into the reader's buffer. Not null terminated. */
+	const char *data;
+	long length;
+};
+
+struct colm_postfix_reader
+{
+	const unsigned char *p;
+	const unsigned char *pe;
+
+	/* What to release on close. */
+	void *map;
+	long map_len;
+	char *buf;
+};
+
+/* Read from a buffer the caller keeps alive. */
+void colm_postfix_open_mem( struct colm_postfix_reader *reader,
+		const char *data, long length );
+
+/* Read the whole of a stream: mapped if it is a plain file, otherwise read
+ * into memory. String streams are used in place. Returns zero if the data
+ * does not start with the magic number. */
+int colm_postfix_open_stream( struct colm_postfix_reader *reader,
+		struct colm_program *prg, struct colm_stream *stream );
+
+/* Returns 1 with the next record, 0 at the end, -1 on a malformed record. */
+int colm_postfix_next( struct colm_postfix_reader *reader,
+		struct colm_postfix_rec *rec );
+
+void colm_postfix_close( struct colm_postfix_reader *reader );
+
+/* Put in the class of a reduction that is run from postfix records: one used
+ * with read_reduce, or a parser-based one compiled with --reduce-thread. It
+ * declares the reader colm generates, which returns zero on a malformed
+ * record. It replaces read_reduce_forward( program_t*, FILE* ), which read
+ * the text form.
+ *
+ * Under --reduce-thread, a reduction runs on the reducer thread only if no
+ * action names prg or pda_run, or uses a tree reference, a location or the
+ * lhs value. The VM keeps running on the parsing thread, so anything else
+ * would race with it. Such reductions stay on the parsing thread. */
+#define COLM_READ_REDUCE_FORWARD \
+	int read_reduce_forward( struct colm_program *prg, \
+			struct colm_postfix_reader *reader, struct read_reduce_node **pstack );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _COLM_POSTFIX_H */
+
@@ -31,35 +31,117 @@
 #include <colm/pool.h>
 #include <colm/bytecode.h>
 #include <colm/debug.h>
+#include <colm/postfix.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define BUFFER_INITIAL_SIZE 4096
 
+/*
+ * Escaping. Each form finds the length of the leading span that prints as it
+ * is, writes the span in one piece, then escapes the byte that stopped it.
+ * With SSE2 the spans are scanned sixteen bytes at a time.
+ */
+
+static inline int xml_clean( char c )
+{
+	return ( 32 <= c && c <= 126 && c != '<' && c != '>' && c != '&' ) ||
+			c == '\t' || c == '\n' || c == '\r';
+}
+
+static long xml_clean_span( const char *data, long len )
+{
+	long i = 0;
+#if defined(__SSE2__)
+	const __m128i lo = _mm_set1_epi8( 31 ), hi = _mm_set1_epi8( 127 );
+	const __m128i lt = _mm_set1_epi8( '<' ), gt = _mm_set1_epi8( '>' );
+	const __m128i amp = _mm_set1_epi8( '&' ), tab = _mm_set1_epi8( '\t' );
+	const __m128i nl = _mm_set1_epi8( '\n' ), cr = _mm_set1_epi8( '\r' );
+	for ( ; i + 16 <= len; i += 16 ) {
+		__m128i v = _mm_loadu_si128( (const __m128i*)( data + i ) );
+		__m128i special = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, lt ),
+				_mm_cmpeq_epi8( v, gt ) ), _mm_cmpeq_epi8( v, amp ) );
+		__m128i space = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, tab ),
+				_mm_cmpeq_epi8( v, nl ) ), _mm_cmpeq_epi8( v, cr ) );
+		__m128i clean = _mm_and_si128( _mm_cmpgt_epi8( v, lo ), _mm_cmplt_epi8( v, hi ) );
+		clean = _mm_or_si128( _mm_andnot_si128( special, clean ), space );
+
+		int mask = _mm_movemask_epi8( clean );
+		if ( mask != 0xffff )
+			return i + __builtin_ctz( ~mask );
+	}
+#endif
+	while ( i < len && xml_clean( data[i] ) )
+		i += 1;
+	return i;
+}
+
 static void xml_escape_data( struct colm_print_args *print_args, const char *data, long len )
 {
-	int i;
-	for ( i = 0; i < len; i++ ) {
+	long i = 0;
+	while ( i < len ) {
+		long span = xml_clean_span( data + i, len - i );
+		if ( span > 0 ) {
+			print_args->out( print_args, data + i, span );
+			i += span;
+			if ( i == len )
+				break;
+		}
+
 		if ( data[i] == '<' )
 			print_args->out( print_args, "&lt;", 4 );
 		else if ( data[i] == '>' )
 			print_args->out( print_args, "&gt;", 4 );
 		else if ( data[i] == '&' )
 			print_args->out( print_args, "&amp;", 5 );
-		else if ( (32 <= data[i] && data[i] <= 126) || 
-				data[i] == '\t' || data[i] == '\n' || data[i] == '\r' )
-		{
-			print_args->out( print_args, &data[i], 1 );
-		}
 		else {
 			char out[64];
 			sprintf( out, "&#%u;", ((unsigned)data[i]) );
 			print_args->out( print_args, out, strlen(out) );
 		}
+		i += 1;
+	}
+}
+
+static void xml_escape_piece( void *arg, const char *data, long length )
+{
+	xml_escape_data( (struct colm_print_args*)arg, data, length );
+}
+
+static inline int postfix_clean( char c )
+{
+	return 33 <= c && c <= 126 && c != '\\';
+}
+
+static long postfix_clean_span( const char *data, long len )
+{
+	long i = 0;
+#if defined(__SSE2__)
+	const __m128i lo = _mm_set1_epi8( 32 ), hi = _mm_set1_epi8( 127 );
+	const __m128i bs = _mm_set1_epi8( '\\' );
+	for ( ; i + 16 <= len; i += 16 ) {
+		__m128i v = _mm_loadu_si128( (const __m128i*)( data + i ) );
+		__m128i clean = _mm_and_si128( _mm_cmpgt_epi8( v, lo ), _mm_cmplt_epi8( v, hi ) );
+		clean = _mm_andnot_si128( _mm_cmpeq_epi8( v, bs ), clean );
+
+		int mask = _mm_movemask_epi8( clean );
+		if ( mask != 0xffff )
+			return i + __builtin_ctz( ~mask );
 	}
+#endif
+	while ( i < len && postfix_clean( data[i] ) )
+		i += 1;
+	return i;
 }
 
+/* The buffer is laid out as a full string allocation, a head followed by the
+ * data, so it can become a string without being copied. */
 void init_str_collect( str_collect_t *collect )
 {
-	collect->data = malloc( BUFFER_INITIAL_SIZE );
+	collect->head = (head_t*) malloc( sizeof(head_t) + BUFFER_INITIAL_SIZE );
+	collect->data = (char*)(collect->head + 1);
 	collect->allocated = BUFFER_INITIAL_SIZE;
 	collect->length = 0;
 	collect->indent.indent = 0;
@@ -68,7 +150,7 @@ void init_str_collect( str_collect_t *collect )
 
 void str_collect_destroy( str_collect_t *collect )
 {
-	free( collect->data );
+	free( collect->head );
 }
 
 void str_collect_append( str_collect_t *collect, const char *data, long len )
@@ -76,11 +158,31 @@ void str_collect_append( str_collect_t *collect, const char *data, long len )
 	long new_len = collect->length + len;
 	if ( new_len > collect->allocated ) {
 		collect->allocated = new_len * 2;
-		collect->data = realloc( collect->data, collect->allocated );
+		collect->head = (head_t*) realloc( collect->head, sizeof(head_t) + collect->allocated );
+		collect->data = (char*)(collect->head + 1);
 	}
 	memcpy( collect->data + collect->length, data, len );
 	collect->length += len;
 }
+
+/* Turn the collected data into a string. Unused space is given back, which
+ * the allocator can normally do in place. The collect is left destroyed. */
+head_t *str_collect_take( str_collect_t *collect )
+{
+	head_t *head = collect->head;
+	if ( collect->length < collect->allocated )
+		head = (head_t*) realloc( head, sizeof(head_t) + collect->length );
+
+	head->data = (char*)(head + 1);
+	head->length = collect->length;
+	head->location = 0;
+
+	collect->head = 0;
+	collect->data = 0;
+	collect->allocated = 0;
+	collect->length = 0;
+	return head;
+}
 		
 void str_collect_clear( str_collect_t *collect )
 {
@@ -89,9 +191,16 @@ void str_collect_clear( str_collect_t *collect )
 
 #define INT_SZ 32
 
+static void print_str_piece( void *arg, const char *data, long length )
+{
+	struct colm_print_args *print_args = (struct colm_print_args*)arg;
+	print_args->out( print_args, data, length );
+}
+
+/* String values built by concatenation are printed piece by piece. */
 void print_str( struct colm_print_args *print_args, head_t *str )
 {
-	print_args->out( print_args, str->data, str->length );
+	string_pieces( str, print_str_piece, print_args );
 }
 
 void append_collect( struct colm_print_args *args, const char *data, int length )
@@ -99,10 +208,49 @@ void append_collect( struct colm_print_args *args, const char *data, int length
 	str_collect_append( (str_collect_t*) args->arg, data, length );
 }
 
+struct print_file
+{
+	struct stream_impl_data *impl;
+	char *buf;
+	long len;
+	long size;
+};
+
+static void print_file_init( program_t *prg, struct print_file *pf,
+		struct stream_impl_data *impl )
+{
+	if ( prg->print_buf == 0 && prg->print_buf_size > 0 )
+		prg->print_buf = malloc( prg->print_buf_size );
+
+	pf->impl = impl;
+	pf->buf = prg->print_buf;
+	pf->len = 0;
+	pf->size = prg->print_buf_size;
+}
+
+static void print_file_flush( struct print_file *pf )
+{
+	if ( pf->len > 0 ) {
+		fwrite( pf->buf, 1, pf->len, pf->impl->file );
+		pf->len = 0;
+	}
+}
+
 void append_file( struct colm_print_args *args, const char *data, int length )
 {
-	struct stream_impl_data *impl = (struct stream_impl_data*) args->arg;
-	fwrite( data, 1, length, impl->file );
+	struct print_file *pf = (struct print_file*) args->arg;
+	if ( pf->len + length > pf->size ) {
+		print_file_flush( pf );
+
+		/* Nothing gained by copying it. */
+		if ( length >= pf->size ) {
+			fwrite( data, 1, length, pf->impl->file );
+			return;
+		}
+	}
+
+	memcpy( pf->buf + pf->len, data, length );
+	pf->len += length;
 }
 
 static void out_indent( struct colm_print_args *args, const char *data, int length )
@@ -119,8 +267,10 @@ restart:
 		if ( length > 0 ) {
 			/* Found some data, print the indentation and turn off indentation
 			 * mode. */
-			for ( level = 0; level < args->indent->level; level++ )
-				args->out( args, "\t", 1 );
+			static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+			const int run = sizeof(tabs) - 1;
+			for ( level = args->indent->level; level > 0; level -= run )
+				args->out( args, tabs, level < run ? level : run );
 
 			args->indent->indent = 0;
 
@@ -256,6 +406,11 @@ rec_call:
 	}
 
 	if ( visit_type == IgnoreWrapper ) {
+		/* The tokens of a lazy ignore list are built the first time it is
+		 * printed. Left lazy when ignores are not wanted. */
+		if ( print_args->comm )
+			colm_ignore_materialize( prg, kid->tree );
+
 		kid_t *new_ignore = kid_allocate( prg );
 		new_ignore->next = leading_ignore;
 		leading_ignore = new_ignore;
@@ -513,13 +668,17 @@ void colm_print_tree_collect_a( program_t *prg, tree_t **sp,
 void colm_print_tree_file( program_t *prg, tree_t **sp,
 		struct stream_impl_data *impl, tree_t *tree, int trim )
 {
+	struct print_file pf;
+	print_file_init( prg, &pf, impl );
+
 	struct colm_print_args print_args = {
-			impl, true, false, trim, &impl->indent,
+			&pf, true, false, trim, &impl->indent,
 			&append_file, &colm_print_null,
 			&colm_print_term_tree, &colm_print_null
 	};
 
 	colm_print_tree_args( prg, sp, &print_args, tree );
+	print_file_flush( &pf );
 }
 
 static void xml_open( program_t *prg, tree_t **sp, struct colm_print_args *args,
@@ -559,7 +718,7 @@ static void xml_term( program_t *prg, tree_t **sp,
 	else if ( kid->tree->id == LEL_ID_STR ) {
 		head_t *head = (head_t*) ((str_t*)kid->tree)->value;
 
-		xml_escape_data( print_args, head->data, head->length );
+		string_pieces( head, xml_escape_piece, print_args );
 	}
 	else if ( 0 < kid->tree->id && kid->tree->id < prg->rtd->first_non_term_id &&
 			kid->tree->id != LEL_ID_IGNORE &&
@@ -598,10 +757,300 @@ void colm_print_xml_stdout( program_t *prg, tree_t **sp,
 		struct stream_impl_data *impl, tree_t *tree,
 		int comm_attr, int trim )
 {
+	struct print_file pf;
+	print_file_init( prg, &pf, impl );
+
 	struct colm_print_args print_args = {
-			impl, comm_attr, comm_attr, trim, &impl->indent,
+			&pf, comm_attr, comm_attr, trim, &impl->indent,
 			&append_file, &xml_open, &xml_term, &xml_close };
 	colm_print_tree_args( prg, sp, &print_args, tree );
+	print_file_flush( &pf );
+}
+
+/* JSON output. A nonterminal is {"name":[...]} and a token is {"name":"data"},
+ * with "@":[line,column,byte] after the data when locations are wanted.
+ * Repeats and lists are flattened into the array of the first one. */
+
+struct json_print_args
+{
+	struct colm_print_args args;
+	int flags;
+	int comma;
+	long depth;
+	int skip;
+};
+
+/* Bytes that need an escape in a JSON string. Bytes above 127 stop the clean
+ * span too: valid UTF-8 sequences are passed through, and any other byte is
+ * taken as Latin-1 and escaped as \u00XX, so the output is always UTF-8. */
+static const char json_escape[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+};
+
+/* Length of the valid UTF-8 sequence of two to four bytes at data, or zero.
+ * Overlong forms and surrogates are not valid. A sequence split between the
+ * pieces of a string is escaped byte by byte. */
+static long json_utf8_seq( const unsigned char *data, long len )
+{
+	long need, i;
+	unsigned char lo = 0x80, hi = 0xbf;
+
+	if ( data[0] >= 0xc2 && data[0] <= 0xdf )
+		need = 2;
+	else if ( data[0] >= 0xe0 && data[0] <= 0xef ) {
+		need = 3;
+		if ( data[0] == 0xe0 )
+			lo = 0xa0;
+		else if ( data[0] == 0xed )
+			hi = 0x9f;
+	}
+	else if ( data[0] >= 0xf0 && data[0] <= 0xf4 ) {
+		need = 4;
+		if ( data[0] == 0xf0 )
+			lo = 0x90;
+		else if ( data[0] == 0xf4 )
+			hi = 0x8f;
+	}
+	else
+		return 0;
+
+	if ( len < need || data[1] < lo || data[1] > hi )
+		return 0;
+	for ( i = 2; i < need; i++ ) {
+		if ( data[i] < 0x80 || data[i] > 0xbf )
+			return 0;
+	}
+	return need;
+}
+
+static long json_clean_span( const unsigned char *data, long len )
+{
+	long i = 0;
+#if defined(__SSE2__)
+	const __m128i ctl = _mm_set1_epi8( 32 );
+	const __m128i quote = _mm_set1_epi8( '"' ), bs = _mm_set1_epi8( '\\' );
+	for ( ; i + 16 <= len; i += 16 ) {
+		/* Signed, so bytes above 127 are below 32 as well. */
+		__m128i v = _mm_loadu_si128( (const __m128i*)( data + i ) );
+		__m128i dirty = _mm_cmplt_epi8( v, ctl );
+		dirty = _mm_or_si128( dirty, _mm_or_si128( _mm_cmpeq_epi8( v, quote ),
+				_mm_cmpeq_epi8( v, bs ) ) );
+
+		int mask = _mm_movemask_epi8( dirty );
+		if ( mask != 0 )
+			return i + __builtin_ctz( mask );
+	}
+#endif
+	while ( i < len && json_escape[data[i]] == 0 )
+		i += 1;
+	return i;
+}
+
+static void json_escape_data( struct colm_print_args *args, const char *data, long len )
+{
+	static const char hex[] = "0123456789abcdef";
+	const unsigned char *p = (const unsigned char*) data;
+	const unsigned char *pe = p + len;
+	while ( p < pe ) {
+		const unsigned char *run = p;
+		long seq;
+		p += json_clean_span( p, pe - p );
+		while ( p < pe && *p >= 0x80 && ( seq = json_utf8_seq( p, pe - p ) ) > 0 )
+			p += seq + json_clean_span( p + seq, pe - p - seq );
+
+		if ( p > run )
+			args->out( args, (const char*)run, p - run );
+
+		if ( p < pe ) {
+			char esc[6] = { '\\', json_escape[*p] };
+			if ( esc[1] == 'u' ) {
+				esc[2] = '0';
+				esc[3] = '0';
+				esc[4] = hex[*p >> 4];
+				esc[5] = hex[*p & 0xf];
+				args->out( args, esc, 6 );
+			}
+			else {
+				args->out( args, esc, 2 );
+			}
+			p += 1;
+		}
+	}
+}
+
+static void json_escape_piece( void *arg, const char *data, long length )
+{
+	json_escape_data( (struct colm_print_args*)arg, data, length );
+}
+
+/* The {"name": opening of each language element, made once per program. */
+static head_t **json_names( program_t *prg )
+{
+	if ( prg->json_names == 0 ) {
+		long num = prg->rtd->num_lang_els;
+		prg->json_names = malloc( sizeof(head_t*) * num );
+
+		str_collect_t collect;
+		struct colm_print_args args;
+		memset( &args, 0, sizeof(args) );
+		args.arg = &collect;
+		args.out = &append_collect;
+
+		long i;
+		for ( i = 0; i < num; i++ ) {
+			const char *name = prg->rtd->lel_info[i].name;
+			init_str_collect( &collect );
+			append_collect( &args, "{\"", 2 );
+			json_escape_data( &args, name, strlen( name ) );
+			append_collect( &args, "\":", 2 );
+
+			prg->json_names[i] = str_collect_take( &collect );
+		}
+	}
+	return prg->json_names;
+}
+
+/* Skipped: the terminal that is for forcing trailing ignores out, the
+ * continuations of flattened lists, and ignore tokens outside the tree, which
+ * would make a second top-level value. */
+static int json_skip( program_t *prg, struct json_print_args *json,
+		kid_t *parent, kid_t *kid )
+{
+	struct lang_el_info *lel_info = prg->rtd->lel_info;
+	if ( kid->tree->id == 0 )
+		return true;
+
+	if ( json->depth == 0 && lel_info[kid->tree->id].ignore )
+		return true;
+
+	return parent != 0 && parent->tree->id == kid->tree->id && kid->next == 0 &&
+			( lel_info[parent->tree->id].repeat || lel_info[parent->tree->id].list );
+}
+
+static void json_open( program_t *prg, tree_t **sp, struct colm_print_args *args,
+		kid_t *parent, kid_t *kid )
+{
+	struct json_print_args *json = (struct json_print_args*) args;
+
+	if ( json_skip( prg, json, parent, kid ) ) {
+		json->skip = kid->tree->id < prg->rtd->first_non_term_id;
+		return;
+	}
+
+	if ( json->comma )
+		args->out( args, ",", 1 );
+
+	head_t *name = json_names( prg )[kid->tree->id];
+	args->out( args, name->data, name->length );
+
+	if ( kid->tree->id < prg->rtd->first_non_term_id ) {
+		args->out( args, "\"", 1 );
+	}
+	else {
+		args->out( args, "[", 1 );
+		json->comma = false;
+		json->depth += 1;
+	}
+}
+
+static void json_term( program_t *prg, tree_t **sp,
+		struct colm_print_args *args, kid_t *kid )
+{
+	if ( ((struct json_print_args*)args)->skip )
+		return;
+
+	if ( kid->tree->id == LEL_ID_PTR ) {
+		char ptr[INT_SZ];
+		sprintf( ptr, "%lx", ((pointer_t*)kid->tree)->value );
+		args->out( args, ptr, strlen(ptr) );
+	}
+	else if ( kid->tree->id == LEL_ID_STR ) {
+		head_t *head = (head_t*) ((str_t*)kid->tree)->value;
+		string_pieces( head, json_escape_piece, args );
+	}
+	else if ( kid->tree->tokdata != 0 ) {
+		json_escape_data( args, string_data( kid->tree->tokdata ),
+				string_length( kid->tree->tokdata ) );
+	}
+}
+
+static void json_close( program_t *prg, tree_t **sp,
+		struct colm_print_args *args, kid_t *parent, kid_t *kid )
+{
+	struct json_print_args *json = (struct json_print_args*) args;
+
+	if ( json_skip( prg, json, parent, kid ) ) {
+		json->skip = false;
+		return;
+	}
+
+	if ( kid->tree->id < prg->rtd->first_non_term_id ) {
+		args->out( args, "\"", 1 );
+
+		head_t *tokdata = kid->tree->tokdata;
+		if ( ( json->flags & COLM_JSON_LOC ) && tokdata != 0 && tokdata->location != 0 ) {
+			char loc[3 * INT_SZ + 8];
+			int len = sprintf( loc, ",\"@\":[%ld,%ld,%ld]", tokdata->location->line,
+					tokdata->location->column, tokdata->location->byte );
+			args->out( args, loc, len );
+		}
+		args->out( args, "}", 1 );
+	}
+	else {
+		args->out( args, "]}", 2 );
+		json->depth -= 1;
+	}
+
+	json->comma = true;
+}
+
+void colm_print_json_file( program_t *prg, tree_t **sp,
+		struct stream_impl_data *impl, tree_t *tree, int flags )
+{
+	struct print_file pf;
+	print_file_init( prg, &pf, impl );
+
+	int comm = ( flags & COLM_JSON_IGNORE ) != 0;
+	struct json_print_args json = { {
+			&pf, comm, false, false, &impl->indent,
+			&append_file, &json_open, &json_term, &json_close
+	}, flags, false, 0, false };
+
+	if ( tree == 0 )
+		append_file( &json.args, "null", 4 );
+	else
+		colm_print_tree_args( prg, sp, &json.args, tree );
+	print_file_flush( &pf );
+}
+
+void colm_print_tree_collect_json( program_t *prg, tree_t **sp,
+		str_collect_t *collect, tree_t *tree, int flags )
+{
+	int comm = ( flags & COLM_JSON_IGNORE ) != 0;
+	struct json_print_args json = { {
+			collect, comm, false, false, &collect->indent,
+			&append_collect, &json_open, &json_term, &json_close
+	}, flags, false, 0, false };
+
+	if ( tree == 0 )
+		append_collect( &json.args, "null", 4 );
+	else
+		colm_print_tree_args( prg, sp, &json.args, tree );
 }
 
 static void postfix_open( program_t *prg, tree_t **sp, struct colm_print_args *args,
@@ -611,17 +1060,21 @@ static void postfix_open( program_t *prg, tree_t **sp, struct colm_print_args *a
 
 static void postfix_term_data( struct colm_print_args *args, const char *data, long len )
 {
-	int i;
-	for ( i = 0; i < len; i++ ) {
-		if ( data[i] == '\\' )
-			args->out( args, "\\5c", 3 );
-		else if ( 33 <= data[i] && data[i] <= 126 )
-			args->out( args, &data[i], 1 );
-		else {
-			char out[64];
-			sprintf( out, "\\%02x", ((unsigned char)data[i]) );
-			args->out( args, out, strlen(out) );
+	static const char hex[] = "0123456789abcdef";
+	long i = 0;
+	while ( i < len ) {
+		long span = postfix_clean_span( data + i, len - i );
+		if ( span > 0 ) {
+			args->out( args, data + i, span );
+			i += span;
+			if ( i == len )
+				break;
 		}
+
+		unsigned char c = data[i];
+		char out[3] = { '\\', hex[c >> 4], hex[c & 0xf] };
+		args->out( args, out, 3 );
+		i += 1;
 	}
 }
 
@@ -735,6 +1188,88 @@ void colm_postfix_tree_collect( program_t *prg, tree_t **sp,
 	colm_print_tree_args( prg, sp, &print_args, tree );
 }
 
+static void postfix_bin_varint( struct colm_print_args *args, unsigned long value )
+{
+	char buf[COLM_POSTFIX_VARINT_MAX];
+	int len = 0;
+	while ( value >= 0x80 ) {
+		buf[len++] = (char)( ( value & 0x7f ) | 0x80 );
+		value >>= 7;
+	}
+	buf[len++] = (char)value;
+	args->out( args, buf, len );
+}
+
+static void postfix_bin_tag( struct colm_print_args *args, char tag )
+{
+	args->out( args, &tag, 1 );
+}
+
+static void postfix_bin_term( program_t *prg, tree_t **sp,
+		struct colm_print_args *args, kid_t *kid )
+{
+	tree_child( prg, kid->tree );
+	if ( kid->tree->id == LEL_ID_PTR )
+		postfix_bin_tag( args, COLM_POSTFIX_PTR );
+	else if ( kid->tree->id == LEL_ID_STR )
+		postfix_bin_tag( args, COLM_POSTFIX_STR );
+	else if ( 0 < kid->tree->id && kid->tree->id < prg->rtd->first_non_term_id &&
+			kid->tree->id != LEL_ID_IGNORE )
+	{
+		struct colm_data *tokdata = kid->tree->tokdata;
+		struct colm_location *loc = tokdata != 0 ? tokdata->location : 0;
+
+		postfix_bin_tag( args, COLM_POSTFIX_TOKEN );
+		postfix_bin_varint( args, kid->tree->id );
+		postfix_bin_varint( args, loc != 0 ? loc->line : 0 );
+		postfix_bin_varint( args, loc != 0 ? loc->column : 0 );
+		postfix_bin_varint( args, loc != 0 ? loc->byte : 0 );
+
+		if ( tokdata == 0 )
+			postfix_bin_varint( args, 0 );
+		else {
+			postfix_bin_varint( args, string_length( tokdata ) );
+			args->out( args, string_data( tokdata ), string_length( tokdata ) );
+		}
+	}
+}
+
+static void postfix_bin_close( program_t *prg, tree_t **sp,
+		struct colm_print_args *args, kid_t *parent, kid_t *kid )
+{
+	/* Skip the terminal that is for forcing trailing ignores out. */
+	if ( kid->tree->id == 0 )
+		return;
+
+	if ( kid->tree->id >= prg->rtd->first_non_term_id ) {
+		int children = 0;
+		kid_t *child = tree_child( prg, kid->tree );
+		while ( child != 0 ) {
+			child = child->next;
+			children += 1;
+		}
+
+		postfix_bin_tag( args, COLM_POSTFIX_REDUCE );
+		postfix_bin_varint( args, kid->tree->id );
+		postfix_bin_varint( args, kid->tree->prod_num );
+		postfix_bin_varint( args, children );
+	}
+}
+
+/* Same walk as the text postfix form, but with varint fields and raw token
+ * data, behind a magic number. Read back with colm_postfix_next(). */
+void colm_postfix_bin_tree_collect( program_t *prg, tree_t **sp,
+		str_collect_t *collect, tree_t *tree )
+{
+	struct colm_print_args print_args = {
+		collect, false, false, false, &collect->indent,
+		&append_collect, &postfix_open, &postfix_bin_term, &postfix_bin_close
+	};
+
+	append_collect( &print_args, COLM_POSTFIX_MAGIC, COLM_POSTFIX_MAGIC_LEN );
+	colm_print_tree_args( prg, sp, &print_args, tree );
+}
+
 #if 0
 void colm_postfix_tree_file( program_t *prg, tree_t **sp, struct stream_impl *impl,
 		tree_t *tree, int trim )
@@ -24,6 +24,13 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "config.h"
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <colm/pdarun.h>
 #include <colm/tree.h>
 #include <colm/bytecode.h>
@@ -39,13 +46,75 @@ static void colm_alloc_global( program_t *prg )
 	prg->global = colm_struct_new( prg, prg->rtd->global_id ) ;
 }
 
-void vm_init( program_t *prg )
+#if defined(HAVE_SYS_MMAN_H)
+
+/* Number of stack slots reserved in the mapped region. Pages are only
+ * committed by the kernel as the stack grows into them. */
+#define VM_STACK_MMAP_SIZE (32 * 1024 * 1024)
+
+/* Reserve the whole stack as one block. The lowest page is a guard that
+ * catches any write past the beginning of the block. If the mapping cannot be
+ * made, returns zero and the caller falls back to malloc blocks. */
+static struct stack_block *vm_map_block()
 {
+	long page = sysconf( _SC_PAGESIZE );
+	size_t len = page + sizeof(tree_t*) * VM_STACK_MMAP_SIZE;
+
+	char *region = mmap( 0, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if ( region == MAP_FAILED )
+		return 0;
+
+	mprotect( region, page, PROT_NONE );
+
 	struct stack_block *b = malloc( sizeof(struct stack_block) );
-	b->data = malloc( sizeof(tree_t*) * VM_STACK_SIZE );
-	b->len = VM_STACK_SIZE;
+	b->data = (tree_t**)( region + page );
+	b->len = VM_STACK_MMAP_SIZE;
 	b->offset = 0;
 	b->next = 0;
+	b->mapped = 1;
+	return b;
+}
+
+static void vm_free_block( struct stack_block *b )
+{
+	if ( b->mapped ) {
+		long page = sysconf( _SC_PAGESIZE );
+		munmap( (char*)b->data - page, page + sizeof(tree_t*) * b->len );
+	}
+	else {
+		free( b->data );
+	}
+	free( b );
+}
+
+#else
+
+static void vm_free_block( struct stack_block *b )
+{
+	free( b->data );
+	free( b );
+}
+
+#endif
+
+void vm_init( program_t *prg )
+{
+	struct stack_block *b = 0;
+
+#if defined(HAVE_SYS_MMAN_H)
+	if ( prg->stack_mmap )
+		b = vm_map_block();
+#endif
+
+	if ( b == 0 ) {
+		b = malloc( sizeof(struct stack_block) );
+		b->data = malloc( sizeof(tree_t*) * VM_STACK_SIZE );
+		b->len = VM_STACK_SIZE;
+		b->offset = 0;
+		b->next = 0;
+		b->mapped = 0;
+	}
 
 	prg->stack_block = b;
 
@@ -85,6 +154,7 @@ tree_t **vm_bs_add( program_t *prg, tree_t **sp, int n )
 		b->data = malloc( sizeof(tree_t*) * size );
 		b->len = size;
 		b->offset = 0;
+		b->mapped = 0;
 
 		prg->stack_block = b;
 	}
@@ -116,10 +186,8 @@ tree_t **vm_bs_pop( program_t *prg, tree_t **sp, int n )
 	
 		/* Clear any previous reserve. We are going to save this block as the
 		 * reserve. */
-		if ( prg->reserve != 0 ) {
-			free( prg->reserve->data );
-			free( prg->reserve );
-		}
+		if ( prg->reserve != 0 )
+			vm_free_block( prg->reserve );
 
 		/* Pop the stack block. */
 		struct stack_block *b = prg->stack_block;
@@ -145,15 +213,32 @@ void vm_clear( program_t *prg )
 	while ( prg->stack_block != 0 ) {
 		struct stack_block *b = prg->stack_block;
 		prg->stack_block = prg->stack_block->next;
-		
-		free( b->data );
-		free( b );
+		vm_free_block( b );
 	}
 
-	if ( prg->reserve != 0 ) {
-		free( prg->reserve->data );
-		free( prg->reserve );
+	if ( prg->reserve != 0 )
+		vm_free_block( prg->reserve );
+}
+
+/* Back to a single, empty block. One popped block is kept as the reserve. */
+static void vm_reset( program_t *prg )
+{
+	while ( prg->stack_block->next != 0 ) {
+		struct stack_block *b = prg->stack_block;
+		prg->stack_block = prg->stack_block->next;
+
+		if ( prg->reserve == 0 )
+			prg->reserve = b;
+		else
+			vm_free_block( b );
 	}
+
+	prg->stack_block->offset = 0;
+	prg->sb_beg = prg->stack_block->data;
+	prg->sb_end = prg->stack_block->data + prg->stack_block->len;
+	prg->sb_total = 0;
+
+	prg->stack_root = prg->sb_end;
 }
 
 tree_t *colm_return_val( struct colm_program *prg )
@@ -171,10 +256,60 @@ void colm_set_reduce_clean( struct colm_program *prg, unsigned char reduce_clean
 	prg->reduce_clean = reduce_clean;
 }
 
+void colm_set_hash_cons( struct colm_program *prg, int hash_cons )
+{
+	prg->hash_cons = hash_cons;
+}
+
+void colm_set_lazy_ignore( struct colm_program *prg, int lazy_ignore )
+{
+	prg->lazy_ignore = lazy_ignore;
+}
+
+void colm_set_reduce_thread( struct colm_program *prg, int reduce_thread )
+{
+	prg->reduce_thread = reduce_thread;
+}
+
+void colm_set_reduce_stream( struct colm_program *prg, int reduce_stream )
+{
+	prg->reduce_stream = reduce_stream;
+}
+
+void colm_set_stack_mmap( struct colm_program *prg, int stack_mmap )
+{
+	/* The stack can only be replaced while nothing is on it. */
+	if ( prg->stack_mmap == stack_mmap || prg->stack_root != prg->sb_end ||
+			prg->stack_block->next != 0 )
+		return;
+
+	vm_clear( prg );
+	prg->stack_block = 0;
+	prg->reserve = 0;
+
+	prg->stack_mmap = stack_mmap;
+	vm_init( prg );
+}
+
+void colm_set_print_buffer( struct colm_program *prg, long size )
+{
+	free( prg->print_buf );
+	prg->print_buf = 0;
+	prg->print_buf_size = size;
+}
+
+void colm_rcode_stats( struct colm_program *prg, long *bytes, long *peak, long *released )
+{
+	*bytes = prg->rcode_stats.bytes;
+	*peak = prg->rcode_stats.peak;
+	*released = prg->rcode_stats.released;
+}
+
 program_t *colm_new_program( struct colm_sections *rtd )
 {
 	program_t *prg = malloc(sizeof(program_t));
 	memset( prg, 0, sizeof(program_t) );
+	int i;
 
 	assert( sizeof(str_t)      <= sizeof(tree_t) );
 	assert( sizeof(pointer_t)  <= sizeof(tree_t) );
@@ -184,6 +319,8 @@ program_t *colm_new_program( struct colm_sections *rtd )
 	prg->reduce_clean = 1;
 
 	init_pool_alloc( &prg->kid_pool, sizeof(kid_t) );
+	for ( i = 0; i < KID_BLOCK_MAX; i++ )
+		init_pool_alloc( &prg->kid_block_pool[i], sizeof(kid_t) * (i+1) );
 	init_pool_alloc( &prg->tree_pool, sizeof(tree_t) );
 	init_pool_alloc( &prg->parse_tree_pool, sizeof(parse_tree_t) );
 	init_pool_alloc( &prg->head_pool, sizeof(head_t) );
@@ -192,6 +329,20 @@ program_t *colm_new_program( struct colm_sections *rtd )
 	prg->true_val = (tree_t*) 1;
 	prg->false_val = (tree_t*) 0;
 
+	prg->gc_enabled = 1;
+	prg->gc_threshold = COLM_GC_MIN_THRESHOLD;
+
+	prg->print_buf_size = COLM_PRINT_BUF_SIZE;
+
+#if defined(VM_STACK_MMAP)
+	prg->stack_mmap = 1;
+#endif
+
+	if ( rtd->num_pat_sets > 0 ) {
+		prg->pat_set_memo = malloc( sizeof(struct pat_set_memo) * rtd->num_pat_sets );
+		memset( prg->pat_set_memo, 0, sizeof(struct pat_set_memo) * rtd->num_pat_sets );
+	}
+
 	/* Allocate the global variable. */
 	colm_alloc_global( prg );
 
@@ -262,25 +413,179 @@ const char *colm_error( struct colm_program *prg, int *length )
 {
 	const char *rtn = 0;
 	if ( prg->error != 0 ) {
-		rtn = prg->error->tokdata->data;
+		rtn = string_data( prg->error->tokdata );
 		if ( length != 0 )
 			*length = prg->error->tokdata->length;
 	}
 	return rtn;
 }
 
+static void free_run_bufs( program_t *prg )
+{
+	struct run_buf *rb = prg->alloc_run_buf;
+	while ( rb != 0 ) {
+		struct run_buf *next = rb->next;
+		free( rb );
+		rb = next;
+	}
+	prg->alloc_run_buf = 0;
+}
+
+static tree_t **global_fields( program_t *prg )
+{
+	return (tree_t**)( prg->global + 1 );
+}
+
+/* Values are copied, so trees are shared with the program and copied on
+ * write as usual. Structs are not copied. */
+struct colm_snapshot *colm_snapshot_program( program_t *prg )
+{
+	struct struct_el_info *sel = colm_sel_info( prg, prg->rtd->global_id );
+	long i;
+
+	struct colm_snapshot *snap = malloc( sizeof(struct colm_snapshot) );
+	snap->size = sel->size;
+	snap->globals = malloc( sizeof(tree_t*) * sel->size );
+	memcpy( snap->globals, global_fields( prg ), sizeof(tree_t*) * sel->size );
+
+	for ( i = 0; i < sel->trees_len; i++ )
+		colm_tree_upref( prg, snap->globals[sel->trees[i]] );
+
+	snap->next = prg->snapshots;
+	prg->snapshots = snap;
+	return snap;
+}
+
+void colm_restore_program( program_t *prg, struct colm_snapshot *snap )
+{
+	struct struct_el_info *sel = colm_sel_info( prg, prg->rtd->global_id );
+	tree_t **sp = prg->stack_root;
+	tree_t **fields = global_fields( prg );
+	long i;
+
+	for ( i = 0; i < sel->trees_len; i++ ) {
+		colm_tree_upref( prg, snap->globals[sel->trees[i]] );
+		colm_tree_downref( prg, sp, fields[sel->trees[i]] );
+	}
+	memcpy( fields, snap->globals, sizeof(tree_t*) * snap->size );
+
+	colm_tree_downref( prg, sp, prg->error );
+	prg->error = 0;
+	prg->induce_exit = 0;
+	prg->exit_status = 0;
+
+	/* Structs made since the snapshot can only be reached from the values
+	 * just replaced. */
+	colm_gc_collect( prg, sp );
+}
+
+static void snapshot_free( program_t *prg, tree_t **sp, struct colm_snapshot *snap )
+{
+	struct struct_el_info *sel = colm_sel_info( prg, prg->rtd->global_id );
+	long i;
+
+	for ( i = 0; i < sel->trees_len; i++ )
+		colm_tree_downref( prg, sp, snap->globals[sel->trees[i]] );
+
+	free( snap->globals );
+	free( snap );
+}
+
+void colm_delete_snapshot( program_t *prg, struct colm_snapshot *snap )
+{
+	struct colm_snapshot **link = &prg->snapshots;
+	while ( *link != snap )
+		link = &(*link)->next;
+	*link = snap->next;
+
+	snapshot_free( prg, prg->stack_root, snap );
+}
+
+/* The parsers themselves are on the heap. */
+static void free_push_parsers( program_t *prg )
+{
+	while ( prg->push_parsers != 0 )
+		colm_push_parser_delete( prg, prg->push_parsers );
+}
+
+static void free_snapshots( program_t *prg, tree_t **sp )
+{
+	while ( prg->snapshots != 0 ) {
+		struct colm_snapshot *next = prg->snapshots->next;
+		snapshot_free( prg, sp, prg->snapshots );
+		prg->snapshots = next;
+	}
+}
+
+/* Everything the program built is released, but the pool blocks and the
+ * stack blocks stay allocated for the next run. Settings
+ * made on the program since it was created are kept. */
+void colm_reset_program( program_t *prg )
+{
+	tree_t **sp = prg->stack_root;
+
+	colm_tree_downref( prg, sp, prg->return_val );
+	prg->return_val = 0;
+
+	free_snapshots( prg, sp );
+	free_push_parsers( prg );
+	colm_hash_cons_clear( prg, sp );
+	colm_clear_heap( prg, sp );
+	prg->heap.head = prg->heap.tail = 0;
+
+	colm_tree_downref( prg, sp, prg->error );
+	prg->error = 0;
+
+	/* Token data may have pointed into consumed run buffers. Nothing does
+	 * now. */
+	free_run_bufs( prg );
+
+	/* The std streams went with the heap. */
+	prg->stdin_val = 0;
+	prg->stdout_val = 0;
+	prg->stderr_val = 0;
+
+	prg->induce_exit = 0;
+	prg->exit_status = 0;
+
+	prg->gc_allocated = 0;
+	prg->gc_threshold = COLM_GC_MIN_THRESHOLD;
+	prg->gc_collections = 0;
+	prg->gc_nest = 0;
+
+	memset( &prg->rcode_stats, 0, sizeof(struct rcode_stats) );
+
+	if ( prg->pat_set_memo != 0 ) {
+		memset( prg->pat_set_memo, 0,
+				sizeof(struct pat_set_memo) * prg->rtd->num_pat_sets );
+	}
+
+	if ( prg->stream_fns == 0 ) {
+		prg->stream_fns = malloc( sizeof(char*) * 1 );
+		prg->stream_fns[0] = 0;
+	}
+
+	vm_reset( prg );
+
+	colm_alloc_global( prg );
+}
+
 int colm_delete_program( program_t *prg )
 {
 	tree_t **sp = prg->stack_root;
 	int exit_status = prg->exit_status;
 
 	colm_tree_downref( prg, sp, prg->return_val );
+	free_snapshots( prg, sp );
+	free_push_parsers( prg );
+	colm_hash_cons_clear( prg, sp );
 	colm_clear_heap( prg, sp );
 
 	colm_tree_downref( prg, sp, prg->error );
 
 #if DEBUG
 	long kid_lost = kid_num_lost( prg );
+	long kid_block_lost = kid_block_num_lost( prg );
 	long tree_lost = tree_num_lost( prg );
 	long parse_tree_lost = parse_tree_num_lost( &prg->parse_tree_pool );
 	long head_lost = head_num_lost( prg );
@@ -289,6 +594,9 @@ int colm_delete_program( program_t *prg )
 	if ( kid_lost )
 		message( "warning: lost kids: %ld\n", kid_lost );
 
+	if ( kid_block_lost )
+		message( "warning: lost kid blocks: %ld\n", kid_block_lost );
+
 	if ( tree_lost )
 		message( "warning: lost trees: %ld\n", tree_lost );
 
@@ -300,23 +608,32 @@ int colm_delete_program( program_t *prg )
 
 	if ( location_lost )
 		message( "warning: lost locations: %ld\n", location_lost );
+
+	if ( prg->rcode_stats.bytes )
+		message( "warning: lost reverse code: %ld bytes\n", prg->rcode_stats.bytes );
 #endif
 
 	kid_clear( prg );
+	kid_block_clear( prg );
 	tree_clear( prg );
 	head_clear( prg );
 	parse_tree_clear( &prg->parse_tree_pool );
 	location_clear( prg );
 
-	struct run_buf *rb = prg->alloc_run_buf;
-	while ( rb != 0 ) {
-		struct run_buf *next = rb->next;
-		free( rb );
-		rb = next;
-	}
+	free_run_bufs( prg );
 
 	vm_clear( prg );
 
+	free( prg->pat_set_memo );
+	free( prg->print_buf );
+
+	if ( prg->json_names != 0 ) {
+		long i;
+		for ( i = 0; i < prg->rtd->num_lang_els; i++ )
+			free( prg->json_names[i] );
+		free( prg->json_names );
+	}
+
 	if ( prg->stream_fns ) {
 		char **ptr = (char**)prg->stream_fns;
 		while ( *ptr != 0 ) {
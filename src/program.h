@@ -35,6 +35,9 @@ struct stack_block
 	int len;
 	int offset;
 	struct stack_block *next;
+
+	/* Reserved with mmap rather than malloc. */
+	int mapped;
 };
 
 struct export_info
@@ -73,6 +76,12 @@ struct colm_sections
 	struct pat_cons_node *pat_repl_nodes;
 	long num_pattern_nodes;
 
+	struct pat_set_info *pat_sets;
+	long num_pat_sets;
+
+	struct pat_auto_node *pat_auto_nodes;
+	long num_pat_auto_nodes;
+
 	struct generic_info *generic_info;
 	long num_generics;
 
@@ -127,7 +136,9 @@ struct colm_sections
 	void (*init_need)();
 	int (*reducer_need_tok)( program_t *prg, struct pda_run *pda_run, int id );
 	int (*reducer_need_ign)( program_t *prg, struct pda_run *pda_run );
-	void (*read_reduce)( program_t *prg, int reducer, input_t *input );
+	int (*read_reduce)( program_t *prg, int reducer, stream_t *stream );
+	int (*postfix_reduce)( program_t *prg, int reducer,
+			struct colm_postfix_reader *reader, void **stack );
 };
 
 struct heap_list
@@ -136,6 +147,38 @@ struct heap_list
 	struct colm_struct *tail;
 };
 
+/* Largest kid block, in kids. Trees with more attributes and children than
+ * this keep a linked child list. */
+#define KID_BLOCK_MAX 8
+
+/* Default size of the buffer that printing to a file stream collects output
+ * in before handing it to stdio. */
+#define COLM_PRINT_BUF_SIZE (64 * 1024)
+
+/* The first member of a pattern set that matched a subject. */
+struct pat_set_memo
+{
+	const tree_t *tree;
+	long first;
+};
+
+/* Global values saved by colm_snapshot_program. Holds its own references to
+ * the trees. */
+struct colm_snapshot
+{
+	tree_t **globals;
+	long size;
+	struct colm_snapshot *next;
+};
+
+/* Parser driven by the host with colm_push_parser_feed. Its parser is a root
+ * for heap collection until the handle is deleted. */
+struct colm_push_parser
+{
+	struct colm_parser *parser;
+	struct colm_push_parser *prev, *next;
+};
+
 struct colm_program
 {
 	long active_realm;
@@ -152,6 +195,7 @@ struct colm_program
 	int exit_status;
 
 	struct pool_alloc kid_pool;
+	struct pool_alloc kid_block_pool[KID_BLOCK_MAX];
 	struct pool_alloc tree_pool;
 	struct pool_alloc parse_tree_pool;
 	struct pool_alloc head_pool;
@@ -162,6 +206,50 @@ struct colm_program
 
 	struct heap_list heap;
 
+	/* Heap collection. Bytes allocated since the last collection are checked
+	 * against the threshold at safe points in the outermost execution. */
+	long gc_allocated;
+	long gc_threshold;
+	long gc_collections;
+	int gc_enabled;
+	int gc_nest;
+
+	/* Hash consing of constructed trees. Open addressing table of canonical
+	 * trees, each holding a reference. */
+	int hash_cons;
+	tree_t **cons_table;
+	long cons_len;
+	long cons_alloc;
+
+	/* Single ignore tokens are attached as lazy ignore lists. */
+	int lazy_ignore;
+
+	/* Parser-based reductions run on a second thread. */
+	int reduce_thread;
+
+	/* Reducers commit whenever the parse cannot backtrack. */
+	int reduce_stream;
+
+	struct rcode_stats rcode_stats;
+
+	/* Live snapshots. What they hold is a root for heap collection. */
+	struct colm_snapshot *snapshots;
+
+	/* Live push parsers. */
+	struct colm_push_parser *push_parsers;
+
+	/* Shared by prints to file streams. Emptied at the end of every print, so
+	 * output order between streams is unchanged. */
+	char *print_buf;
+	long print_buf_size;
+
+	/* Made on the first JSON print. */
+	head_t **json_names;
+
+	/* Decisions made by the lead member of each pattern set, consulted by
+	 * the members that follow it. */
+	struct pat_set_memo *pat_set_memo;
+
 	stream_t *stdin_val;
 	stream_t *stdout_val;
 	stream_t *stderr_val;
@@ -178,6 +266,9 @@ struct colm_program
 	struct stack_block *stack_block;
 	tree_t **stack_root;
 
+	/* Reserve the stack with mmap, see colm_set_stack_mmap. */
+	int stack_mmap;
+
 	/* Returned value for main program and any exported functions. */
 	tree_t *return_val;
 
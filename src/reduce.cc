@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdbool.h>
+#include <ctype.h>
 
 #include <iostream>
 
@@ -43,7 +44,9 @@ void Compiler::writeCommitStub()
 		"int " << objectName << "_reducer_need_ign( program_t *prg, "
 				"struct pda_run *pda_run ) { return COLM_RN_BOTH; }\n"
 		"\n"
-		"void " << objectName << "_read_reduce( program_t *prg, int reducer, input_t *stream ) {}\n"
+		"int " << objectName << "_read_reduce( program_t *prg, int reducer, stream_t *stream ) { return 0; }\n"
+		"int " << objectName << "_postfix_reduce( program_t *prg, int reducer,\n"
+		"		struct colm_postfix_reader *reader, void **stack ) { return 0; }\n"
 	;
 }
 
@@ -547,49 +550,53 @@ void Compiler::writeReduceStructs()
 	*outStream <<
 		"struct read_reduce_node\n"
 		"{\n"
-		"	std::string name;\n"
+		"	read_reduce_node() : owned(false) {}\n"
+		"	~read_reduce_node() { if ( owned ) free( (void*)data.data ); }\n"
+		"\n"
+		"	const char *name;\n"
 		"	int id;\n"
 		"	int prod_num;\n"
 		"	colm_location loc;\n"
 		"	colm_data data;\n"
+		"	bool owned;\n"
 		"	commit_reduce_union u;\n"
 		"	read_reduce_node *next;\n"
 		"	read_reduce_node *child;\n"
 		"};\n"
 		"\n";
-}
 
+	/* Token data points into the reader's buffer. Nodes that outlive it, on
+	 * the reducer thread's stack between chunks, take a copy. */
+	if ( threadReduce() ) {
+		*outStream <<
+			"static void read_reduce_own( read_reduce_node *stack )\n"
+			"{\n"
+			"	for ( ; stack != 0 && !stack->owned; stack = stack->next ) {\n"
+			"		char *data = 0;\n"
+			"		if ( stack->data.length > 0 ) {\n"
+			"			data = (char*)malloc( stack->data.length );\n"
+			"			memcpy( data, stack->data.data, stack->data.length );\n"
+			"		}\n"
+			"		stack->data.data = data;\n"
+			"		stack->owned = true;\n"
+			"	}\n"
+			"}\n"
+			"\n";
+	}
 
-void Compiler::writeUnescape()
-{
 	*outStream <<
-		"static void unescape( colm_data *tokdata )\n"
+		"static void read_reduce_free( read_reduce_node *stack )\n"
 		"{\n"
-		"	unsigned char *src = (unsigned char*)tokdata->data, *dest = (unsigned char*)tokdata->data;\n"
-		"	while ( *src != 0 ) {\n"
-		"		if ( *src == '\\\\' ) {\n"
-		"			unsigned int i;\n"
-		"			char buf[3];\n"
-		"\n"
-		"			src += 1;\n"
-		"			buf[0] = *src++;\n"
-		"			buf[1] = *src++;\n"
-		"			buf[2] = 0;\n"
-		"\n"
-		"			sscanf( buf, \"%x\", &i );\n"
-		"			*dest++ = (unsigned char)i;\n"
-		"\n"
-		"			tokdata->length -= 2;\n"
-		"		}\n"
-		"		else {\n"
-		"			*dest++ = *src++;\n"
-		"		}\n"
+		"	while ( stack != 0 ) {\n"
+		"		read_reduce_node *next = stack->next;\n"
+		"		delete stack;\n"
+		"		stack = next;\n"
 		"	}\n"
-		"	*dest = 0;\n"
 		"}\n"
 		"\n";
 }
 
+
 void Compiler::writeReduceDispatchers()
 {
 	*outStream <<
@@ -615,9 +622,15 @@ void Compiler::writeReduceDispatchers()
 		"}\n"
 		"\n";
 
+	/* Returns zero if the stream does not hold well-formed postfix data. */
 	*outStream <<
-		"extern \"C\" void " << objectName << "_read_reduce( program_t *prg, int reducer, stream_t *stream )\n"
+		"extern \"C\" int " << objectName << "_read_reduce( program_t *prg, int reducer, stream_t *stream )\n"
 		"{\n"
+		"	struct colm_postfix_reader reader;\n"
+		"	read_reduce_node *stack = 0;\n"
+		"	int res = 0;\n"
+		"	if ( !colm_postfix_open_stream( &reader, prg, stream ) )\n"
+		"		return 0;\n"
 		"	switch ( reducer ) {\n";
 
 	for ( ReductionVect::Iter r = rootNamespace->reductions; r.lte(); r++ ) {
@@ -625,13 +638,55 @@ void Compiler::writeReduceDispatchers()
 		if ( reduction->postfixBased ) {
 			*outStream <<
 				"	case " << reduction->id << ":\n"
-				"		((" << reduction->name << "*)prg->red_ctx)->read_reduce_forward( prg, stream->impl->file );\n"
+				"		res = ((" << reduction->name << "*)prg->red_ctx)->read_reduce_forward( prg, &reader, &stack );\n"
 				"		break;\n";
 		}
 	}
 
 	*outStream <<
 		"	}\n"
+		"	read_reduce_free( stack );\n"
+		"	colm_postfix_close( &reader );\n"
+		"	return res;\n"
+		"}\n"
+		"\n";
+
+	/* Called by the reducer thread, once per chunk of records. With no reader
+	 * it frees the stack, and with neither it asks if the reducer is
+	 * supported. */
+	*outStream <<
+		"extern \"C\" int " << objectName << "_postfix_reduce( program_t *prg, int reducer,\n"
+		"		struct colm_postfix_reader *reader, void **stack )\n"
+		"{\n";
+
+	if ( threadReduce() ) {
+		*outStream <<
+			"	read_reduce_node **pstack = (read_reduce_node**)stack;\n"
+			"	switch ( reducer ) {\n";
+
+		for ( ReductionVect::Iter r = rootNamespace->reductions; r.lte(); r++ ) {
+			Reduction *reduction = *r;
+			if ( threadReduce( reduction ) ) {
+				*outStream <<
+					"	case " << reduction->id << ":\n"
+					"		if ( reader != 0 ) {\n"
+					"			((" << reduction->name << "*)prg->red_ctx)->read_reduce_forward( prg, reader, pstack );\n"
+					"			read_reduce_own( *pstack );\n"
+					"		}\n"
+					"		else if ( pstack != 0 ) {\n"
+					"			read_reduce_free( *pstack );\n"
+					"			*pstack = 0;\n"
+					"		}\n"
+					"		return 1;\n";
+			}
+		}
+
+		*outStream <<
+			"	}\n";
+	}
+
+	*outStream <<
+		"	return 0;\n"
 		"}\n"
 		"\n";
 }
@@ -752,9 +807,7 @@ void Compiler::writeParseReduce( Reduction *reduction )
 		"\n"
 		"	commit_clear_parse_tree( prg, sp, pda_run, lel->child );\n"
 		"	if ( prg->reduce_clean ) {\n"
-		"		commit_clear_kid_list( prg, sp, kid->tree->child );\n"
-		"		kid->tree->child = 0;\n"
-		"		kid->tree->flags &= ~( AF_LEFT_IGNORE | AF_RIGHT_IGNORE );\n"
+		"		commit_clear_children( prg, sp, kid->tree );\n"
 		"	}\n"
 		"	lel->child = 0;\n"
 		"\n"
@@ -775,47 +828,107 @@ void Compiler::writeParseReduce()
 	}
 }
 
+/* Does host text use an identifier, as a whole word? */
+static bool txtUsesIdent( const String &txt, const char *ident )
+{
+	long len = strlen( ident );
+	for ( const char *p = strstr( txt.data, ident ); p != 0; p = strstr( p + 1, ident ) ) {
+		if ( ( p == txt.data || !( isalnum( p[-1] ) || p[-1] == '_' ) ) &&
+				!( isalnum( p[len] ) || p[len] == '_' ) )
+			return true;
+	}
+	return false;
+}
+
+/* Parser-based reductions can also be run from postfix records on a reducer
+ * thread. The records carry token data and the shape of the tree, so not if
+ * an action needs the tree itself, a location, or the parser. Nor if it sets
+ * the lhs value, which is kept with the parse tree, or uses the program,
+ * which the VM goes on using on the parsing thread. */
+bool Compiler::threadReduce( Reduction *reduction )
+{
+	if ( !gblReduceThread || !reduction->parserBased )
+		return false;
+
+	for ( ReduceActionList::Iter rdi = reduction->reduceActions; rdi.lte(); rdi++ ) {
+		for ( ReduceTextItemList::Iter i = rdi->itemList; i.lte(); i++ ) {
+			if ( i->type == ReduceTextItem::TreeRef ||
+					i->type == ReduceTextItem::RhsLoc ||
+					i->type == ReduceTextItem::LhsRef )
+				return false;
+
+			if ( i->type == ReduceTextItem::Txt && ( txtUsesIdent( i->txt, "pda_run" ) ||
+					txtUsesIdent( i->txt, "prg" ) ) )
+				return false;
+		}
+	}
+	return true;
+}
+
+bool Compiler::threadReduce()
+{
+	for ( ReductionVect::Iter r = rootNamespace->reductions; r.lte(); r++ ) {
+		if ( threadReduce( *r ) )
+			return true;
+	}
+	return false;
+}
+
+bool Compiler::postfixReduce( Reduction *reduction )
+{
+	return reduction->postfixBased || threadReduce( reduction );
+}
+
 void Compiler::writePostfixReduce( Reduction *reduction )
 {
+	/* Token data points into the reader's buffer and is only valid for the
+	 * duration of the read. The stack carries over between calls. Records
+	 * are checked against the program's tables, and an action only runs if
+	 * its node has the production's number of children. Returns zero on a
+	 * malformed record. */
 	*outStream <<
-		"void " << reduction->name << "::read_reduce_forward( program_t *prg, FILE *file )\n"
+		"int " << reduction->name << "::read_reduce_forward( program_t *prg,\n"
+		"		struct colm_postfix_reader *reader, read_reduce_node **pstack )\n"
 		"{\n"
-		"	__gnu_cxx::stdio_filebuf<char> fbuf( file, std::ios::in|std::ios::out|std::ios::app );\n"
-		"	std::iostream in( &fbuf );\n"
-		"	std::string type, tok, text;\n"
-		"	long _id, line, column, byte, prod_num, children;\n"
-		"	read_reduce_node sentinal;\n"
-		"	sentinal.next = 0;\n"
-		"	read_reduce_node *stack = &sentinal, *last = 0;\n"
-		"	while ( in >> type ) {\n"
+		"	struct colm_postfix_rec rec;\n"
+		"	read_reduce_node *stack = *pstack, *last = 0;\n"
+		"	long children;\n"
+		"	int res;\n"
+		"	while ( ( res = colm_postfix_next( reader, &rec ) ) > 0 ) {\n"
 		"		/* read. */\n"
-		"		if ( type == \"t\" ) {\n"
-		"			in >> tok >> _id >> line >> column >> byte >> text;\n"
+		"		if ( rec.type == COLM_POSTFIX_TOKEN ) {\n"
+		"			if ( rec.id >= prg->rtd->first_non_term_id )\n"
+		"				goto malformed;\n"
+		"\n"
 		"			read_reduce_node *node = new read_reduce_node;\n"
-		"			node->name = tok;\n"
-		"			node->id = _id;\n"
+		"			node->name = prg->rtd->lel_info[rec.id].xml_tag;\n"
+		"			node->id = rec.id;\n"
 		"			node->loc.name = \"<>\";\n"
-		"			node->loc.line = line;\n"
-		"			node->loc.column = column;\n"
-		"			node->loc.byte = byte;\n"
-		"			node->data.data = strdup( text.c_str() );\n"
-		"			node->data.length = text.size();\n"
-		"			unescape( &node->data );\n"
+		"			node->loc.line = rec.line;\n"
+		"			node->loc.column = rec.column;\n"
+		"			node->loc.byte = rec.byte;\n"
+		"			node->data.data = rec.data;\n"
+		"			node->data.length = rec.length;\n"
+		"			node->data.location = 0;\n"
 		"\n"
 		"			node->next = stack;\n"
 		"			node->child = 0;\n"
 		"			stack = node;\n"
 		"		}\n"
-		"		else if ( type == \"r\" ) {\n"
-		"			in >> tok >> _id >> prod_num >> children;\n"
+		"		else if ( rec.type == COLM_POSTFIX_REDUCE ) {\n"
+		"			if ( rec.id < prg->rtd->first_non_term_id ||\n"
+		"					rec.id >= prg->rtd->num_lang_els ||\n"
+		"					rec.prod_num >= prg->rtd->num_prods )\n"
+		"				goto malformed;\n"
+		"\n"
 		"			read_reduce_node *node = new read_reduce_node;\n"
 		"			memset( &node->loc, 0, sizeof(colm_location) );\n"
 		"			memset( &node->data, 0, sizeof(colm_data) );\n"
-		"			node->name = tok;\n"
-		"			node->id = _id;\n"
-		"			node->prod_num = prod_num;\n"
+		"			node->name = prg->rtd->lel_info[rec.id].xml_tag;\n"
+		"			node->id = rec.id;\n"
+		"			node->prod_num = rec.prod_num;\n"
 		"			node->child = 0;\n"
-		"			while ( children-- > 0 ) {\n"
+		"			for ( children = 0; children < rec.children && stack != 0; children++ ) {\n"
 		"				last = stack;\n"
 		"				stack = stack->next;\n"
 		"				last->next = node->child;\n"
@@ -825,6 +938,9 @@ void Compiler::writePostfixReduce( Reduction *reduction )
 		"			node->next = stack;\n"
 		"			stack = node;\n"
 		"\n"
+		"			if ( children < rec.children )\n"
+		"				goto malformed;\n"
+		"\n"
 		"			{ switch ( node->id ) {\n";
 
 	/* Populate a vector with the reduce actions. */
@@ -863,7 +979,9 @@ void Compiler::writePostfixReduce( Reduction *reduction )
 		}
 
 		*outStream << 
-			"			if ( node->prod_num == " << prodNum << " ) {\n";
+			"			if ( node->prod_num == " << prodNum << " ) {\n"
+			"				if ( children != " << action->production->prodElList->length() << " )\n"
+			"					goto malformed;\n";
 
 		loadRefs( reduction, action->production, action->itemList, true );
 
@@ -893,23 +1011,25 @@ void Compiler::writePostfixReduce( Reduction *reduction )
 		"				delete last;\n"
 		"				last = next;\n"
 		"			}\n"
+		"			node->child = 0;\n"
 		"		}\n"
 		"	}\n"
+		"	*pstack = stack;\n"
+		"	return res == 0;\n"
+		"\n"
+		"malformed:\n"
+		"	*pstack = stack;\n"
+		"	return 0;\n"
 		"}\n"
 		"\n";
 }
 
 void Compiler::writePostfixReduce()
 {
-	bool unescape = false;
 	for ( ReductionVect::Iter r = rootNamespace->reductions; r.lte(); r++ ) {
 		Reduction *reduction = *r;
-		if ( reduction->postfixBased ) {
-			if ( !unescape )
-				writeUnescape();
-
+		if ( postfixReduce( reduction ) )
 			writePostfixReduce( reduction );
-		}
 	}
 }
 
@@ -923,6 +1043,7 @@ void Compiler::writeCommit()
 		"#include <colm/tree.h>\n"
 		"#include <colm/program.h>\n"
 		"#include <colm/colm.h>\n"
+		"#include <colm/postfix.h>\n"
 		"\n"
 		"#include <stdio.h>\n"
 		"#include <stdlib.h>\n"
@@ -931,8 +1052,6 @@ void Compiler::writeCommit()
 		"#include <errno.h>\n"
 		"\n"
 		"#include <iostream>\n"
-		/* Not available on MAC OS. */
-		// "#include <ext/stdio_filebuf.h>\n"
 		"#include <fstream>\n"
 		"\n"
 		"using std::endl;\n"
@@ -946,7 +1065,7 @@ void Compiler::writeCommit()
 	
 	writeReduceDispatchers();
 
-	//writePostfixReduce();
+	writePostfixReduce();
 
 	writeParseReduce();
 
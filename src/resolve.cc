@@ -313,6 +313,51 @@ UniqueType *TypeRef::resolveTypeMap( Compiler *pd )
 	return pd->findUniqueType( TYPE_GENERIC, inMap->generic );
 }
 
+UniqueType *TypeRef::resolveTypeVector( Compiler *pd )
+{
+	nspace = pd->rootNamespace;
+
+	UniqueType *utValue = typeRef1->resolveType( pd );	
+
+	UniqueGeneric *inMap = 0, searchKey( UniqueGeneric::Vector, utValue );
+	if ( uniqueGeneric( inMap, pd, searchKey ) ) {
+		GenericType *generic = new GenericType( GEN_VECTOR,
+				pd->nextGenericId++, typeRef1, 0, typeRef1, 0 );
+
+		nspace->genericList.append( generic );
+
+		generic->declare( pd, nspace );
+
+		inMap->generic = generic;
+	}
+
+	generic = inMap->generic;
+	return pd->findUniqueType( TYPE_GENERIC, inMap->generic );
+}
+
+UniqueType *TypeRef::resolveTypeHashMap( Compiler *pd )
+{
+	nspace = pd->rootNamespace;
+
+	UniqueType *utKey = typeRef1->resolveType( pd );
+	UniqueType *utValue = typeRef2->resolveType( pd );
+
+	UniqueGeneric *inMap = 0, searchKey( UniqueGeneric::HashMap, utKey, utValue );
+	if ( uniqueGeneric( inMap, pd, searchKey ) ) {
+		GenericType *generic = new GenericType( GEN_HASHMAP,
+				pd->nextGenericId++, typeRef2, typeRef1, typeRef2, 0 );
+
+		nspace->genericList.append( generic );
+
+		generic->declare( pd, nspace );
+
+		inMap->generic = generic;
+	}
+
+	generic = inMap->generic;
+	return pd->findUniqueType( TYPE_GENERIC, inMap->generic );
+}
+
 UniqueType *TypeRef::resolveTypeParser( Compiler *pd )
 {
 	nspace = pd->rootNamespace;
@@ -470,6 +515,14 @@ UniqueType *TypeRef::resolveType( Compiler *pd )
 		case MapEl:
 			uniqueType = resolveTypeMapEl( pd );
 			break;
+
+		case Vector:
+			uniqueType = resolveTypeVector( pd );
+			break;
+
+		case HashMap:
+			uniqueType = resolveTypeHashMap( pd );
+			break;
 			
 		case Unspecified:
 			/* No lookup needed, unique type(s) set when constructed. */
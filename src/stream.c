@@ -880,7 +880,7 @@ stream_t *colm_stream_new_struct( program_t *prg )
 	size_t memsize = sizeof(struct colm_stream);
 	struct colm_stream *stream = (struct colm_stream*) malloc( memsize );
 	memset( stream, 0, memsize );
-	colm_struct_add( prg, (struct colm_struct *)stream );
+	colm_struct_add( prg, (struct colm_struct *)stream, memsize );
 	stream->id = prg->rtd->struct_stream_id;
 	stream->destructor = &colm_stream_destroy;
 	return stream;
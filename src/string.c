@@ -32,14 +32,14 @@
 
 str_t *string_prefix( program_t *prg, str_t *str, long len )
 {
-	head_t *head = string_alloc_full( prg, str->value->data, len );
+	head_t *head = string_alloc_full( prg, string_data( str->value ), len );
 	return (str_t*)construct_string( prg, head );
 }
 
 str_t *string_suffix( program_t *prg, str_t *str, long pos )
 {
 	long len = str->value->length - pos;
-	head_t *head = string_alloc_full( prg, str->value->data + pos, len );
+	head_t *head = string_alloc_full( prg, string_data( str->value ) + pos, len );
 	return (str_t*)construct_string( prg, head );
 }
 
@@ -53,6 +53,260 @@ tree_t *construct_string( program_t *prg, head_t *s )
 }
 
 
+/*
+ * Concatenation results are ropes: a node that refers to its two operands
+ * instead of copying them. Building a string with a run of concatenations
+ * then costs the size of the pieces, not the square of the result. The
+ * data is flattened into a single buffer the first time something needs it
+ * in one piece and the operands are let go. Printing walks the pieces.
+ *
+ * A rope node starts with a head that has no data pointer. Nodes are shared
+ * between results by counting references. Operands that are not ropes are
+ * copied into a leaf, since pointer heads can refer to input data that does
+ * not outlive the operand.
+ *
+ * A leaf is a slice of a buffer. A short right operand gets a buffer with
+ * room to spare, and a later result that appends to the slice ending where
+ * the buffer's used space ends takes the next bytes of the same buffer. Runs
+ * of small appends then use a node and a slice per result, freed with the
+ * result it replaces, rather than a node and a copy per operand.
+ */
+
+struct colm_rope
+{
+	head_t head;
+	long refs;
+	head_t *left;
+	head_t *right;
+
+	/* Full allocation holding the data, once flattened. */
+	head_t *flat;
+};
+
+/* Data follows. Bytes past used belong to no slice yet. */
+struct rope_buf
+{
+	long refs;
+	long used;
+	long alloc;
+};
+
+struct rope_leaf
+{
+	head_t head;
+	long refs;
+	struct rope_buf *buf;
+};
+
+/* Results shorter than this are copied, as before. */
+#define ROPE_MIN 256
+
+/* Smallest buffer a right operand is copied into. */
+#define ROPE_LEAF 4096
+
+static int is_rope( head_t *head )
+{
+	return head->data == 0 && head->length > 0;
+}
+
+struct rope_stack
+{
+	head_t **data;
+	long len;
+	long alloc;
+};
+
+static void rope_push( struct rope_stack *stack, head_t *head )
+{
+	if ( stack->len == stack->alloc ) {
+		stack->alloc = stack->alloc == 0 ? 32 : stack->alloc * 2;
+		stack->data = (head_t**) realloc( stack->data, sizeof(head_t*) * stack->alloc );
+	}
+	stack->data[stack->len++] = head;
+}
+
+/* Chains of concatenations are as deep as they are long, so ropes are
+ * walked with an explicit stack. */
+void string_pieces( head_t *head, void (*piece)( void *arg, const char *data, long length ),
+		void *arg )
+{
+	struct rope_stack stack = { 0, 0, 0 };
+	rope_push( &stack, head );
+	while ( stack.len > 0 ) {
+		head_t *h = stack.data[--stack.len];
+		if ( !is_rope( h ) ) {
+			if ( h->length > 0 )
+				piece( arg, h->data, h->length );
+		}
+		else {
+			struct colm_rope *rope = (struct colm_rope*)h;
+			if ( rope->flat != 0 )
+				piece( arg, rope->flat->data, rope->flat->length );
+			else {
+				rope_push( &stack, rope->right );
+				rope_push( &stack, rope->left );
+			}
+		}
+	}
+	free( stack.data );
+}
+
+static void rope_release( head_t *head )
+{
+	struct rope_stack stack = { 0, 0, 0 };
+	rope_push( &stack, head );
+	while ( stack.len > 0 ) {
+		head_t *h = stack.data[--stack.len];
+		if ( !is_rope( h ) ) {
+			struct rope_leaf *leaf = (struct rope_leaf*)h;
+			if ( --leaf->refs == 0 ) {
+				if ( --leaf->buf->refs == 0 )
+					free( leaf->buf );
+				free( leaf );
+			}
+		}
+		else {
+			struct colm_rope *rope = (struct colm_rope*)h;
+			if ( --rope->refs == 0 ) {
+				if ( rope->flat != 0 )
+					free( rope->flat );
+				else {
+					rope_push( &stack, rope->right );
+					rope_push( &stack, rope->left );
+				}
+				free( rope );
+			}
+		}
+	}
+	free( stack.data );
+}
+
+static void rope_copy_piece( void *arg, const char *data, long length )
+{
+	char **dest = (char**)arg;
+	memcpy( *dest, data, length );
+	*dest += length;
+}
+
+static head_t *rope_flatten( struct colm_rope *rope )
+{
+	if ( rope->flat == 0 ) {
+		head_t *flat = init_str_space( rope->head.length );
+		char *dest = (char*)(flat+1);
+		string_pieces( &rope->head, rope_copy_piece, &dest );
+
+		rope_release( rope->left );
+		rope_release( rope->right );
+		rope->left = rope->right = 0;
+		rope->flat = flat;
+	}
+	return rope->flat;
+}
+
+static head_t *rope_leaf_new( struct rope_buf *buf, const char *data, long length )
+{
+	struct rope_leaf *leaf = (struct rope_leaf*) malloc( sizeof(struct rope_leaf) );
+	leaf->head.data = data;
+	leaf->head.length = length;
+	leaf->head.location = 0;
+	leaf->refs = 1;
+	leaf->buf = buf;
+	buf->refs += 1;
+	return &leaf->head;
+}
+
+static head_t *rope_new( head_t *left, head_t *right )
+{
+	struct colm_rope *rope = (struct colm_rope*) malloc( sizeof(struct colm_rope) );
+	rope->head.data = 0;
+	rope->head.length = left->length + right->length;
+	rope->head.location = 0;
+	rope->refs = 1;
+	rope->left = left;
+	rope->right = right;
+	rope->flat = 0;
+	return &rope->head;
+}
+
+/* Another reference to a node or leaf. */
+static head_t *rope_ref( head_t *head )
+{
+	if ( is_rope( head ) )
+		((struct colm_rope*)head)->refs += 1;
+	else
+		((struct rope_leaf*)head)->refs += 1;
+	return head;
+}
+
+/* A rope operand is shared. Anything else is copied into a new buffer of at
+ * least alloc bytes. */
+static head_t *rope_operand( head_t *s, long alloc )
+{
+	if ( is_rope( s ) )
+		return rope_ref( s );
+
+	if ( alloc < s->length )
+		alloc = s->length;
+
+	struct rope_buf *buf = (struct rope_buf*) malloc( sizeof(struct rope_buf) + alloc );
+	buf->refs = 0;
+	buf->used = s->length;
+	buf->alloc = alloc;
+	memcpy( (buf+1), s->data, s->length );
+	return rope_leaf_new( buf, (char*)(buf+1), s->length );
+}
+
+/* Appends s2 to the last leaf of s1 when that leaf ends where its buffer's
+ * used space does and the rest of s2 fits. Returns zero otherwise. */
+static head_t *rope_append( head_t *s1, head_t *s2 )
+{
+	if ( !is_rope( s1 ) )
+		return 0;
+
+	struct colm_rope *rope = (struct colm_rope*)s1;
+	if ( rope->flat != 0 || is_rope( rope->right ) )
+		return 0;
+
+	struct rope_leaf *leaf = (struct rope_leaf*)rope->right;
+	struct rope_buf *buf = leaf->buf;
+	char *end = (char*)(buf+1) + buf->used;
+	if ( leaf->head.data + leaf->head.length != end ||
+			buf->used + s2->length > buf->alloc )
+		return 0;
+
+	string_pieces( s2, rope_copy_piece, &end );
+	buf->used += s2->length;
+
+	return rope_new( rope_ref( rope->left ),
+			rope_leaf_new( buf, leaf->head.data, leaf->head.length + s2->length ) );
+}
+
+/* The data of a tree for code that reads heads directly, such as host
+ * calls. A string value that is a rope is replaced by its flat data. */
+head_t *colm_tree_data( program_t *prg, tree_t *tree )
+{
+	if ( tree == 0 )
+		return 0;
+
+	if ( tree->id == LEL_ID_STR ) {
+		str_t *str = (str_t*)tree;
+		if ( str->value != 0 && is_rope( str->value ) ) {
+			struct colm_rope *rope = (struct colm_rope*)str->value;
+			head_t *flat = rope_flatten( rope );
+			if ( rope->refs == 1 ) {
+				str->value = flat;
+				free( rope );
+			}
+			else {
+				str->value = string_alloc_full( prg, flat->data, flat->length );
+				rope->refs -= 1;
+			}
+		}
+	}
+
+	return tree->tokdata;
+}
+
 /* 
  * In this system strings are not null terminated. Often strings come from a
  * parse, in which case the string is just a pointer into the the data stream.
@@ -64,7 +318,9 @@ head_t *string_copy( program_t *prg, head_t *head )
 {
 	head_t *result = 0;
 	if ( head != 0 ) {
-		if ( (char*)(head+1) == head->data )
+		if ( is_rope( head ) )
+			result = string_alloc_full( prg, string_data( head ), head->length );
+		else if ( (char*)(head+1) == head->data )
 			result = string_alloc_full( prg, head->data, head->length );
 		else
 			result = colm_string_alloc_pointer( prg, head->data, head->length );
@@ -86,7 +342,10 @@ void string_free( program_t *prg, head_t *head )
 		if ( head->location != 0 )
 			location_free( prg, head->location );
 
-		if ( (char*)(head+1) == head->data ) {
+		if ( is_rope( head ) ) {
+			rope_release( head );
+		}
+		else if ( (char*)(head+1) == head->data ) {
 			/* Full string allocation. */
 			free( head );
 		}
@@ -101,6 +360,8 @@ const char *string_data( head_t *head )
 {
 	if ( head == 0 )
 		return 0;
+	if ( is_rope( head ) )
+		return rope_flatten( (struct colm_rope*)head )->data;
 	return head->data;
 }
 
@@ -161,12 +422,20 @@ head_t *concat_str( head_t *s1, head_t *s2 )
 	long s1Len = s1->length;
 	long s2Len = s2->length;
 
+	if ( s1Len + s2Len >= ROPE_MIN ) {
+		head_t *appended = rope_append( s1, s2 );
+		if ( appended != 0 )
+			return appended;
+
+		return rope_new( rope_operand( s1, 0 ), rope_operand( s2, ROPE_LEAF ) );
+	}
+
 	/* Init space for the data. */
 	head_t *head = init_str_space( s1Len + s2Len );
 
 	/* Copy in the data. */
-	memcpy( (head+1), s1->data, s1Len );
-	memcpy( (char*)(head+1) + s1Len, s2->data, s2Len );
+	memcpy( (head+1), string_data( s1 ), s1Len );
+	memcpy( (char*)(head+1) + s1Len, string_data( s2 ), s2Len );
 
 	return head;
 }
@@ -178,7 +447,7 @@ head_t *string_to_upper( head_t *s )
 	head_t *head = init_str_space( len );
 
 	/* Copy in the data. */
-	const char *src = s->data;
+	const char *src = string_data( s );
 	char *dst = (char*)(head+1);
 	int i;
 	for ( i = 0; i < len; i++ )
@@ -194,7 +463,7 @@ head_t *string_to_lower( head_t *s )
 	head_t *head = init_str_space( len );
 
 	/* Copy in the data. */
-	const char *src = s->data;
+	const char *src = string_data( s );
 	char *dst = (char*)(head+1);
 	int i;
 	for ( i = 0; i < len; i++ )
@@ -212,44 +481,95 @@ word_t cmp_string( head_t *s1, head_t *s2 )
 	else if ( s1->length > s2->length )
 		return 1;
 	else {
-		char *d1 = (char*)(s1->data);
-		char *d2 = (char*)(s2->data);
+		const char *d1 = string_data( s1 );
+		const char *d2 = string_data( s2 );
 		return memcmp( d1, d2, s1->length );
 	}
 }
 
+/* FNV-1a over the string data. Equal strings (by cmp_string) hash equally. */
+word_t hash_string( head_t *head )
+{
+	const uchar *p = (const uchar*)string_data( head );
+	const uchar *end = p + head->length;
+	word_t h = (word_t)14695981039346656037ULL;
+	while ( p < end ) {
+		h ^= *p++;
+		h *= (word_t)1099511628211ULL;
+	}
+	return h;
+}
+
+/* Convert the leading integer in a string the same way strtol does, but
+ * without needing a null terminated copy of the data. Skips leading
+ * whitespace and accepts an optional sign. */
+static long str_to_long( head_t *str, int base )
+{
+	const char *p = string_data( str );
+	const char *end = p + str->length;
+	ulong res = 0;
+	int neg = 0;
+
+	while ( p < end && isspace( (uchar)*p ) )
+		p += 1;
+
+	if ( p < end && ( *p == '-' || *p == '+' ) ) {
+		neg = *p == '-';
+		p += 1;
+	}
+
+	while ( p < end ) {
+		int digit = *p - '0';
+		if ( digit < 0 || digit >= base )
+			break;
+		res = res * base + digit;
+		p += 1;
+	}
+
+	return neg ? -(long)res : (long)res;
+}
+
 word_t str_atoi( head_t *str )
 {
-	/* FIXME: need to implement this by hand. There is no null terminator. */
-	char *nulled = (char*)malloc( str->length + 1 );
-	memcpy( nulled, str->data, str->length );
-	nulled[str->length] = 0;
-	int res = atoi( nulled );
-	free( nulled );
-	return res;
+	return str_to_long( str, 10 );
 }
 
 word_t str_atoo( head_t *str )
 {
-	/* FIXME: need to implement this by hand. There is no null terminator. */
-	char *nulled = (char*)malloc( str->length + 1 );
-	memcpy( nulled, str->data, str->length );
-	nulled[str->length] = 0;
-	int res = strtol( nulled, 0, 8 );
-	free( nulled );
-	return res;
+	return str_to_long( str, 8 );
+}
+
+/* Longest decimal representation of a long, including the sign. */
+#define LONG_STR_MAX ( sizeof(long) * 3 + 1 )
+
+/* Write the decimal representation of an integer to the end of the buffer,
+ * returning a pointer to the first character. */
+static char *long_to_str_buf( char *end, long i )
+{
+	ulong u = i < 0 ? -(ulong)i : (ulong)i;
+	char *p = end;
+	do {
+		*(--p) = '0' + ( u % 10 );
+		u /= 10;
+	}
+	while ( u != 0 );
+
+	if ( i < 0 )
+		*(--p) = '-';
+	return p;
 }
 
 head_t *int_to_str( program_t *prg, word_t i )
 {
-	char data[20];
-	sprintf( data, "%ld", i );
-	return string_alloc_full( prg, data, strlen(data) );
+	char data[LONG_STR_MAX];
+	char *end = data + sizeof(data);
+	char *start = long_to_str_buf( end, (long)i );
+	return string_alloc_full( prg, start, end - start );
 }
 
 word_t str_uord16( head_t *head )
 {
-	uchar *data = (uchar*)(head->data);
+	const uchar *data = (const uchar*)string_data( head );
 	ulong res;
 	res =   (ulong)data[1];
 	res |= ((ulong)data[0]) << 8;
@@ -258,7 +578,7 @@ word_t str_uord16( head_t *head )
 
 word_t str_uord8( head_t *head )
 {
-	uchar *data = (uchar*)(head->data);
+	const uchar *data = (const uchar*)string_data( head );
 	ulong res = (ulong)data[0];
 	return res;
 }
@@ -273,9 +593,32 @@ head_t *make_literal( program_t *prg, long offset )
 head_t *string_sprintf( program_t *prg, str_t *format, long integer )
 {
 	head_t *format_head = format->value;
-	long written = snprintf( 0, 0, (char*)string_data(format_head), integer );
-	head_t *head = init_str_space( written+1 );
-	written = snprintf( (char*)head->data, written+1, (char*)string_data(format_head), integer );
-	head->length -= 1;
+	long flen = format_head->length;
+
+	/* Format strings are not null terminated. Short formats are terminated
+	 * in a stack buffer. */
+	char fbuf[128];
+	char *fmt = flen < (long)sizeof(fbuf) ? fbuf : (char*)malloc( flen + 1 );
+	memcpy( fmt, string_data( format_head ), flen );
+	fmt[flen] = 0;
+
+	/* Most results are short. Format into a stack buffer and only format a
+	 * second time when it does not fit. */
+	char buf[64];
+	long written = snprintf( buf, sizeof(buf), fmt, integer );
+
+	head_t *head;
+	if ( written < (long)sizeof(buf) ) {
+		head = init_str_space( written );
+		memcpy( (char*)(head+1), buf, written );
+	}
+	else {
+		head = init_str_space( written + 1 );
+		snprintf( (char*)(head+1), written + 1, fmt, integer );
+		head->length -= 1;
+	}
+
+	if ( fmt != fbuf )
+		free( fmt );
 	return head;
 }
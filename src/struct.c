@@ -26,7 +26,11 @@
 
 #include <colm/program.h>
 #include <colm/struct.h>
+#include <colm/pdarun.h>
+#include <colm/input.h>
+#include <colm/pool.h>
 
+#include "config.h"
 #include "internal.h"
 #include "bytecode.h"
 
@@ -35,8 +39,12 @@ struct colm_tree *colm_get_global( program_t *prg, long pos )
 	return colm_struct_get_field( prg->global, tree_t*, pos );
 }
 
-void colm_struct_add( program_t *prg, struct colm_struct *item )
+void colm_struct_add( program_t *prg, struct colm_struct *item, long size )
 {
+	item->gc_mark = 0;
+	item->gc_size = size;
+	prg->gc_allocated += size;
+
 	if ( prg->heap.head == 0 ) {
 		prg->heap.head = prg->heap.tail = item;
 		item->prev = item->next = 0;
@@ -55,7 +63,7 @@ struct colm_struct *colm_struct_new_size( program_t *prg, int size )
 	struct colm_struct *item = (struct colm_struct*) malloc( memsize );
 	memset( item, 0, memsize );
 
-	colm_struct_add( prg, item );
+	colm_struct_add( prg, item, memsize );
 	return item;
 }
 
@@ -112,7 +120,8 @@ parser_t *colm_parser_new( program_t *prg, struct generic_info *gi, int stop_id,
 	size_t memsize = sizeof(struct colm_parser);
 	struct colm_parser *parser = (struct colm_parser*) malloc( memsize );
 	memset( parser, 0, memsize );
-	colm_struct_add( prg, (struct colm_struct*) parser );
+	colm_struct_add( prg, (struct colm_struct*) parser, memsize );
+	prg->gc_allocated += sizeof(struct pda_run);
 
 	parser->id = prg->rtd->struct_inbuilt_id;
 	parser->destructor = &colm_parser_destroy;
@@ -139,7 +148,7 @@ map_t *colm_map_new( struct colm_program *prg )
 	size_t memsize = sizeof(struct colm_map);
 	struct colm_map *map = (struct colm_map*) malloc( memsize );
 	memset( map, 0, memsize );
-	colm_struct_add( prg, (struct colm_struct *)map );
+	colm_struct_add( prg, (struct colm_struct *)map, memsize );
 	map->id = prg->rtd->struct_inbuilt_id;
 	return map;
 }
@@ -161,6 +170,18 @@ struct_t *colm_construct_generic( program_t *prg, long generic_id, int stop_id )
 			new_generic = (struct_t*) list;
 			break;
 		}
+		case GEN_VECTOR: {
+			vector_t *vector = colm_vector_new( prg );
+			vector->generic_info = generic_info;
+			new_generic = (struct_t*) vector;
+			break;
+		}
+		case GEN_HASHMAP: {
+			hashmap_t *map = colm_hashmap_new( prg );
+			map->generic_info = generic_info;
+			new_generic = (struct_t*) map;
+			break;
+		}
 		case GEN_PARSER: {
 			parser_t *parser = colm_parser_new( prg, generic_info, stop_id, 0 );
 			parser->input = colm_input_new( prg );
@@ -183,3 +204,271 @@ struct_t *colm_construct_reducer( program_t *prg, long generic_id, int reducer_i
 
 	return new_generic;
 }
+
+/*
+ * Heap collection
+ *
+ * Mark and sweep over the structs linked on prg->heap. Roots are the globals,
+ * the std streams, the VM stack and value attributes held in pointer trees.
+ * Struct contents, parser state and reverse code are scanned conservatively:
+ * any word that falls inside a heap object keeps it alive. This covers the
+ * interior pointers that list and map elements use.
+ */
+
+struct gc_ctx
+{
+	program_t *prg;
+
+	/* Heap objects sorted by address. */
+	struct colm_struct **objs;
+	long nobjs;
+
+	/* Stream structs sorted by impl. */
+	stream_t **streams;
+	long nstreams;
+
+	/* Marked objects waiting to be scanned. */
+	struct colm_struct **stack;
+	long stack_len;
+	long stack_alloc;
+};
+
+static int gc_cmp_addr( const void *a, const void *b )
+{
+	const struct colm_struct *s1 = *(struct colm_struct *const *)a;
+	const struct colm_struct *s2 = *(struct colm_struct *const *)b;
+	return s1 < s2 ? -1 : ( s1 > s2 ? 1 : 0 );
+}
+
+static int gc_cmp_impl( const void *a, const void *b )
+{
+	const struct stream_impl *i1 = (*(stream_t *const *)a)->impl;
+	const struct stream_impl *i2 = (*(stream_t *const *)b)->impl;
+	return i1 < i2 ? -1 : ( i1 > i2 ? 1 : 0 );
+}
+
+static void gc_mark( struct gc_ctx *gc, struct colm_struct *s )
+{
+	if ( s->gc_mark )
+		return;
+
+	s->gc_mark = 1;
+	if ( gc->stack_len == gc->stack_alloc ) {
+		gc->stack_alloc = gc->stack_alloc == 0 ? 256 : gc->stack_alloc * 2;
+		gc->stack = (struct colm_struct**) realloc( gc->stack,
+				sizeof(struct colm_struct*) * gc->stack_alloc );
+	}
+	gc->stack[gc->stack_len++] = s;
+}
+
+/* Find the object containing an address, if any. */
+static void gc_mark_word( struct gc_ctx *gc, word_t w )
+{
+	char *p = (char*)w;
+	if ( gc->nobjs == 0 || p < (char*)gc->objs[0] )
+		return;
+
+	long low = 0, high = gc->nobjs - 1;
+	while ( low < high ) {
+		long mid = ( low + high + 1 ) / 2;
+		if ( (char*)gc->objs[mid] <= p )
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	struct colm_struct *s = gc->objs[low];
+	if ( p < (char*)s + s->gc_size )
+		gc_mark( gc, s );
+}
+
+static void gc_scan_words( struct gc_ctx *gc, void *data, long len )
+{
+	word_t *w = (word_t*)data;
+	long i;
+	for ( i = 0; i < len; i++ )
+		gc_mark_word( gc, w[i] );
+}
+
+/* Reverse code stores words unaligned. */
+static void gc_scan_bytes( struct gc_ctx *gc, const code_t *data, long len )
+{
+	long i;
+	for ( i = 0; i + (long)sizeof(word_t) <= len; i++ ) {
+		word_t w;
+		memcpy( &w, data + i, sizeof(word_t) );
+		gc_mark_word( gc, w );
+	}
+}
+
+static void gc_mark_stream_impl( void *ctx, struct stream_impl *si )
+{
+	struct gc_ctx *gc = (struct gc_ctx*)ctx;
+	long low = 0, high = gc->nstreams - 1;
+	while ( low <= high ) {
+		long mid = ( low + high ) / 2;
+		struct stream_impl *mi = gc->streams[mid]->impl;
+		if ( mi == si ) {
+			gc_mark( gc, (struct colm_struct*)gc->streams[mid] );
+			return;
+		}
+		else if ( mi < si )
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+}
+
+static void gc_scan_struct( struct gc_ctx *gc, struct colm_struct *s )
+{
+	program_t *prg = gc->prg;
+
+	/* Skip the header, the heap links would keep everything alive. */
+	gc_scan_words( gc, s + 1, ( s->gc_size - sizeof(struct colm_struct) ) / sizeof(word_t) );
+
+	if ( s->id == prg->rtd->struct_inbuilt_id &&
+			((struct colm_inbuilt*)s)->destructor == &colm_parser_destroy )
+	{
+		struct pda_run *pda_run = ((parser_t*)s)->pda_run;
+		gc_scan_words( gc, pda_run, sizeof(struct pda_run) / sizeof(word_t) );
+		struct rcode_chunk *chunk;
+		for ( chunk = pda_run->reverse_code.top; chunk != 0; chunk = chunk->prev )
+			gc_scan_bytes( gc, chunk->data, chunk->len );
+		gc_scan_bytes( gc, pda_run->rcode_collect.data, pda_run->rcode_collect.tab_len );
+	}
+	else if ( s->id == prg->rtd->struct_inbuilt_id &&
+			((struct colm_inbuilt*)s)->destructor == &colm_vector_destroy )
+	{
+		vector_t *vector = (vector_t*)s;
+		gc_scan_words( gc, vector->data, vector->len );
+	}
+	else if ( s->id == prg->rtd->struct_inbuilt_id &&
+			((struct colm_inbuilt*)s)->destructor == &colm_hashmap_destroy )
+	{
+		hashmap_t *map = (hashmap_t*)s;
+		gc_scan_words( gc, map->slots,
+				map->alloc * sizeof(hashmap_slot_t) / sizeof(word_t) );
+	}
+	else if ( s->id == prg->rtd->struct_input_id ) {
+		colm_input_shared_streams( ((input_t*)s)->impl, &gc_mark_stream_impl, gc );
+	}
+}
+
+/* Pointer trees carry value attributes. Free items have their value cleared,
+ * and the unused tail of the newest block is skipped. */
+static void gc_scan_pointers( struct gc_ctx *gc )
+{
+	struct pool_alloc *pool = &gc->prg->tree_pool;
+	struct pool_block *block;
+	long nitems = pool->nextel;
+	for ( block = pool->head; block != 0; block = block->next ) {
+		long i;
+		for ( i = 0; i < nitems; i++ ) {
+			tree_t *tree = (tree_t*)( (char*)block->data + pool->sizeofT * i );
+			if ( tree->id == LEL_ID_PTR )
+				gc_mark_word( gc, ((pointer_t*)tree)->value );
+		}
+		nitems = FRESH_BLOCK;
+	}
+}
+
+static void gc_scan_stack( struct gc_ctx *gc, tree_t **sp )
+{
+	program_t *prg = gc->prg;
+	struct stack_block *b = prg->stack_block;
+
+	gc_scan_words( gc, sp, prg->sb_end - sp );
+	for ( b = b->next; b != 0; b = b->next )
+		gc_scan_words( gc, b->data + b->offset, b->len - b->offset );
+}
+
+void colm_gc_collect( program_t *prg, tree_t **sp )
+{
+#ifndef POOL_MALLOC
+	struct gc_ctx gc;
+	memset( &gc, 0, sizeof(gc) );
+	gc.prg = prg;
+
+	struct colm_struct *s;
+	for ( s = prg->heap.head; s != 0; s = s->next ) {
+		gc.nobjs += 1;
+		if ( s->id == prg->rtd->struct_stream_id )
+			gc.nstreams += 1;
+	}
+
+	gc.objs = (struct colm_struct**) malloc( sizeof(struct colm_struct*) * ( gc.nobjs + 1 ) );
+	gc.streams = (stream_t**) malloc( sizeof(stream_t*) * ( gc.nstreams + 1 ) );
+
+	long o = 0, n = 0;
+	for ( s = prg->heap.head; s != 0; s = s->next ) {
+		gc.objs[o++] = s;
+		if ( s->id == prg->rtd->struct_stream_id )
+			gc.streams[n++] = (stream_t*)s;
+	}
+
+	qsort( gc.objs, gc.nobjs, sizeof(struct colm_struct*), &gc_cmp_addr );
+	qsort( gc.streams, gc.nstreams, sizeof(stream_t*), &gc_cmp_impl );
+
+	/* Roots. */
+	if ( prg->global != 0 )
+		gc_mark( &gc, prg->global );
+	if ( prg->stdin_val != 0 )
+		gc_mark( &gc, (struct colm_struct*)prg->stdin_val );
+	if ( prg->stdout_val != 0 )
+		gc_mark( &gc, (struct colm_struct*)prg->stdout_val );
+	if ( prg->stderr_val != 0 )
+		gc_mark( &gc, (struct colm_struct*)prg->stderr_val );
+
+	struct colm_snapshot *snap;
+	for ( snap = prg->snapshots; snap != 0; snap = snap->next )
+		gc_scan_words( &gc, snap->globals, snap->size );
+
+	struct colm_push_parser *pp;
+	for ( pp = prg->push_parsers; pp != 0; pp = pp->next )
+		gc_mark( &gc, (struct colm_struct*)pp->parser );
+
+	gc_scan_stack( &gc, sp );
+	gc_scan_pointers( &gc );
+
+	while ( gc.stack_len > 0 )
+		gc_scan_struct( &gc, gc.stack[--gc.stack_len] );
+
+	/* Sweep. */
+	long live = 0;
+	s = prg->heap.head;
+	while ( s != 0 ) {
+		struct colm_struct *next = s->next;
+		if ( s->gc_mark ) {
+			s->gc_mark = 0;
+			live += s->gc_size;
+		}
+		else {
+			if ( s->prev == 0 )
+				prg->heap.head = next;
+			else
+				s->prev->next = next;
+
+			if ( next == 0 )
+				prg->heap.tail = s->prev;
+			else
+				next->prev = s->prev;
+
+			colm_struct_delete( prg, sp, s );
+		}
+		s = next;
+	}
+
+	free( gc.objs );
+	free( gc.streams );
+	free( gc.stack );
+
+	prg->gc_collections += 1;
+	prg->gc_allocated = 0;
+	prg->gc_threshold = live > COLM_GC_MIN_THRESHOLD ? live : COLM_GC_MIN_THRESHOLD;
+#endif
+}
+
+void colm_gc_enable( program_t *prg, int enabled )
+{
+	prg->gc_enabled = enabled;
+}
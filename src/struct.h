@@ -30,9 +30,13 @@ extern "C" {
 typedef void (*colm_destructor_t)( struct colm_program *prg,
 		tree_t **sp, struct colm_struct *s );
 
+/* Every heap object starts with this header. The size is recorded so the
+ * collector can scan the object and resolve interior pointers into it. */
 struct colm_struct
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 };
 
@@ -40,6 +44,8 @@ struct colm_struct
 struct colm_inbuilt
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 };
@@ -48,6 +54,8 @@ struct colm_inbuilt
 typedef struct colm_parser
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 
@@ -60,6 +68,8 @@ typedef struct colm_parser
 typedef struct colm_input
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 
@@ -70,6 +80,8 @@ typedef struct colm_input
 typedef struct colm_stream
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 
@@ -87,6 +99,8 @@ typedef struct colm_list_el
 typedef struct colm_list
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 
@@ -95,6 +109,44 @@ typedef struct colm_list
 	struct generic_info *generic_info;
 } list_t;
 
+/* Must overlay colm_inbuilt. Values are stored contiguously. */
+typedef struct colm_vector
+{
+	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
+	struct colm_struct *prev, *next;
+	colm_destructor_t destructor;
+
+	colm_value_t *data;
+	long len;
+	long alloc;
+	struct generic_info *generic_info;
+} vector_t;
+
+/* Open addressing slot. A zero hash marks an empty slot. */
+typedef struct colm_hashmap_slot
+{
+	unsigned long hash;
+	colm_value_t key;
+	colm_value_t value;
+} hashmap_slot_t;
+
+/* Must overlay colm_inbuilt. */
+typedef struct colm_hashmap
+{
+	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
+	struct colm_struct *prev, *next;
+	colm_destructor_t destructor;
+
+	hashmap_slot_t *slots;
+	long len;
+	long alloc;
+	struct generic_info *generic_info;
+} hashmap_t;
+
 typedef struct colm_map_el
 {
 	tree_t *key;
@@ -110,6 +162,8 @@ typedef struct colm_map_el
 typedef struct colm_map
 {
 	short id;
+	unsigned short gc_mark;
+	unsigned int gc_size;
 	struct colm_struct *prev, *next;
 	colm_destructor_t destructor;
 
@@ -120,10 +174,18 @@ typedef struct colm_map
 
 struct colm_struct *colm_struct_new_size( struct colm_program *prg, int size );
 struct colm_struct *colm_struct_new( struct colm_program *prg, int id );
-void colm_struct_add( struct colm_program *prg, struct colm_struct *item );
+void colm_struct_add( struct colm_program *prg, struct colm_struct *item, long size );
+struct struct_el_info *colm_sel_info( struct colm_program *prg, int id );
 void colm_struct_delete( struct colm_program *prg, struct colm_tree **sp,
 		struct colm_struct *el );
 
+/* Bytes of heap structs that must be allocated before the first collection.
+ * After a collection the threshold is the larger of this and the live size. */
+#define COLM_GC_MIN_THRESHOLD (1024 * 1024)
+
+void colm_gc_collect( struct colm_program *prg, struct colm_tree **sp );
+void colm_gc_enable( struct colm_program *prg, int enabled );
+
 struct colm_struct *colm_struct_inbuilt( struct colm_program *prg, int size,
 		colm_destructor_t destructor );
 
@@ -167,6 +229,24 @@ struct colm_struct *colm_map_el_get( struct colm_program *prg,
 struct colm_struct *colm_map_get( struct colm_program *prg, map_t *map,
 		word_t gen_id, word_t field );
 
+vector_t *colm_vector_new( struct colm_program *prg );
+void colm_vector_destroy( struct colm_program *prg, tree_t **sp, struct colm_struct *s );
+void colm_vector_push( struct colm_program *prg, vector_t *vector, colm_value_t value );
+colm_value_t colm_vector_pop( struct colm_program *prg, vector_t *vector );
+colm_value_t colm_vector_get( struct colm_program *prg, vector_t *vector, long pos );
+colm_value_t colm_vector_set( struct colm_program *prg, vector_t *vector,
+		long pos, colm_value_t value );
+long colm_vector_length( vector_t *vector );
+
+hashmap_t *colm_hashmap_new( struct colm_program *prg );
+void colm_hashmap_destroy( struct colm_program *prg, tree_t **sp, struct colm_struct *s );
+int colm_hashmap_insert( struct colm_program *prg, hashmap_t *map,
+		colm_value_t key, colm_value_t value );
+colm_value_t colm_hashmap_find( struct colm_program *prg, hashmap_t *map, colm_value_t key );
+int colm_hashmap_remove( struct colm_program *prg, hashmap_t *map, colm_value_t key,
+		colm_value_t *rkey, colm_value_t *rvalue );
+long colm_hashmap_length( hashmap_t *map );
+
 struct colm_struct *colm_construct_generic( struct colm_program *prg, long generic_id, int stop_id );
 struct colm_struct *colm_construct_reducer( struct colm_program *prg, long generic_id, int reducer_id );
 struct input_impl *input_to_impl( input_t *ptr );
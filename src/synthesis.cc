@@ -187,6 +187,28 @@ IterImpl::IterImpl( Type type ) :
 		useGenericId = true;
 		break;
 
+	case VectorVal:
+		inCreateWV =   IN_GEN_ITER_FROM_REF;
+		inCreateWC =   IN_GEN_ITER_FROM_REF;
+		inUnwind =     IN_GEN_ITER_UNWIND;
+		inDestroy =    IN_GEN_ITER_DESTROY;
+		inAdvance =    IN_VECTOR_ITER_ADVANCE;
+
+		inGetCurR =    IN_VECTOR_ITER_GET_CUR_R;
+		useGenericId = true;
+		break;
+
+	case HashMapVal:
+		inCreateWV =   IN_GEN_ITER_FROM_REF;
+		inCreateWC =   IN_GEN_ITER_FROM_REF;
+		inUnwind =     IN_GEN_ITER_UNWIND;
+		inDestroy =    IN_GEN_ITER_DESTROY;
+		inAdvance =    IN_HASHMAP_ITER_ADVANCE;
+
+		inGetCurR =    IN_HASHMAP_ITER_GET_CUR_R;
+		useGenericId = true;
+		break;
+
 	case MapEl:
 		inCreateWV =   IN_GEN_ITER_FROM_REF;
 		inCreateWC =   IN_GEN_ITER_FROM_REF;
@@ -926,6 +948,12 @@ IterImpl *LangVarRef::chooseTriterCall( Compiler *pd,
 				iterImpl = new IterImpl( IterImpl::ListVal );
 		}
 
+		if ( exprUT->typeId == TYPE_GENERIC && exprUT->generic->typeId == GEN_VECTOR )
+			iterImpl = new IterImpl( IterImpl::VectorVal );
+
+		if ( exprUT->typeId == TYPE_GENERIC && exprUT->generic->typeId == GEN_HASHMAP )
+			iterImpl = new IterImpl( IterImpl::HashMapVal );
+
 		if ( exprUT->typeId == TYPE_GENERIC && exprUT->generic->typeId == GEN_MAP ) {
 			if ( searchUT == exprUT->generic->elUt )
 				iterImpl = new IterImpl( IterImpl::MapEl );
@@ -1055,6 +1083,26 @@ bool LangVarRef::isFinishCall( VarRefLookup &lookup ) const
 	return lookup.objMethod->type == ObjectMethod::ParseFinish;
 }
 
+/* True if both references name the same field through the same
+ * qualification. */
+bool LangVarRef::sameRef( Compiler *pd, const LangVarRef *other ) const
+{
+	if ( strcmp( name, other->name ) != 0 ||
+			qual->length() != other->qual->length() )
+		return false;
+
+	for ( int i = 0; i < qual->length(); i++ ) {
+		if ( qual->data[i].form != other->qual->data[i].form ||
+				strcmp( qual->data[i].data, other->qual->data[i].data ) != 0 )
+			return false;
+	}
+
+	VarRefLookup lookup = lookupField( pd );
+	VarRefLookup otherLookup = other->lookupField( pd );
+	return lookup.inObject == otherLookup.inObject &&
+			lookup.objField == otherLookup.objField;
+}
+
 void LangVarRef::callOperation( Compiler *pd, CodeVect &code, VarRefLookup &lookup ) const
 {
 	/* This is for writing if it is a non-const builtin. */
@@ -2110,6 +2158,58 @@ UniqueType *LangExpr::evaluate( Compiler *pd, CodeVect &code ) const
 							"operator for these types" << endp;
 					break;
 				}
+				case '%': {
+					UniqueType *lt = left->evaluate( pd, code );
+					UniqueType *rt = right->evaluate( pd, code );
+
+					if ( lt == pd->uniqueTypeInt && rt == pd->uniqueTypeInt ) {
+						code.append( IN_MOD_INT );
+						return pd->uniqueTypeInt;
+					}
+
+					error(loc) << "do not have a modulus "
+							"operator for these types" << endp;
+					break;
+				}
+				case '&': {
+					UniqueType *lt = left->evaluate( pd, code );
+					UniqueType *rt = right->evaluate( pd, code );
+
+					if ( lt == pd->uniqueTypeInt && rt == pd->uniqueTypeInt ) {
+						code.append( IN_BIT_AND_INT );
+						return pd->uniqueTypeInt;
+					}
+
+					error(loc) << "do not have a bitwise and "
+							"operator for these types" << endp;
+					break;
+				}
+				case '|': {
+					UniqueType *lt = left->evaluate( pd, code );
+					UniqueType *rt = right->evaluate( pd, code );
+
+					if ( lt == pd->uniqueTypeInt && rt == pd->uniqueTypeInt ) {
+						code.append( IN_BIT_OR_INT );
+						return pd->uniqueTypeInt;
+					}
+
+					error(loc) << "do not have a bitwise or "
+							"operator for these types" << endp;
+					break;
+				}
+				case '^': {
+					UniqueType *lt = left->evaluate( pd, code );
+					UniqueType *rt = right->evaluate( pd, code );
+
+					if ( lt == pd->uniqueTypeInt && rt == pd->uniqueTypeInt ) {
+						code.append( IN_BIT_XOR_INT );
+						return pd->uniqueTypeInt;
+					}
+
+					error(loc) << "do not have a bitwise xor "
+							"operator for these types" << endp;
+					break;
+				}
 				case OP_DoubleEql: {
 					UniqueType *lt = left->evaluate( pd, code );
 					UniqueType *rt = right->evaluate( pd, code );
@@ -2265,10 +2365,12 @@ UniqueType *LangExpr::evaluate( Compiler *pd, CodeVect &code ) const
 				case '$': {
 					UniqueType *ut = right->evaluate( pd, code );
 
+					/* Integers convert directly. The result has no whitespace
+					 * to trim, so skip the second print and copy. */
 					if ( ut->typeId == TYPE_INT || ut->typeId == TYPE_BOOL )
 						code.append( IN_INT_TO_STR );
-
-					code.append( IN_TREE_TO_STR_TRIM );
+					else
+						code.append( IN_TREE_TO_STR_TRIM );
 					return pd->uniqueTypeStr;
 					
 				}
@@ -2277,8 +2379,8 @@ UniqueType *LangExpr::evaluate( Compiler *pd, CodeVect &code ) const
 
 					if ( ut->typeId == TYPE_INT || ut->typeId == TYPE_BOOL )
 						code.append( IN_INT_TO_STR );
-
-					code.append( IN_TREE_TO_STR_TRIM_A );
+					else
+						code.append( IN_TREE_TO_STR_TRIM_A );
 					return pd->uniqueTypeStr;
 				}
 				case '%': {
@@ -2564,6 +2666,105 @@ void LangStmt::compileForIter( Compiler *pd, CodeVect &code ) const
 	}
 }
 
+/* Collects the matches of a chain of ifs that test one subject in a row,
+ * such as the cases of a switch, into a pattern set. Production comparisons
+ * may sit between them, anything else ends the set. */
+void LangStmt::findPatternSet( Compiler *pd ) const
+{
+	if ( expr->type != LangExpr::TermType ||
+			expr->term->type != LangTerm::MatchType ||
+			expr->term->pattern->patSet >= 0 )
+		return;
+
+	LangTerm *lead = expr->term;
+	Vector<Pattern*> members;
+	members.append( lead->pattern );
+	long leading = -1;
+
+	for ( LangStmt *stmt = elsePart; stmt != 0 && stmt->type == IfType;
+			stmt = stmt->elsePart )
+	{
+		if ( stmt->expr->type != LangExpr::TermType )
+			break;
+
+		LangTerm *term = stmt->expr->term;
+		if ( term->type == LangTerm::ProdCompareType && term->expr == 0 ) {
+			if ( leading < 0 )
+				leading = members.length();
+			continue;
+		}
+
+		if ( term->type != LangTerm::MatchType ||
+				!term->varRef->sameRef( pd, lead->varRef ) )
+			break;
+
+		members.append( term->pattern );
+	}
+
+	if ( members.length() > 1 ) {
+		long patSet = pd->nextPatSetId++;
+		for ( int i = 0; i < members.length(); i++ ) {
+			members[i]->patSet = patSet;
+			members[i]->setIndex = i;
+		}
+
+		pd->patSetSize.append( members.length() );
+		pd->patSetLeading.append( leading < 0 ? members.length() : leading );
+		pd->patSetTable.append( -1 );
+	}
+}
+
+/* The pattern of an if that belongs to a pattern set, or nil. */
+Pattern *LangStmt::setPattern() const
+{
+	if ( expr->type == LangExpr::TermType &&
+			expr->term->type == LangTerm::MatchType &&
+			expr->term->pattern->patSet >= 0 )
+		return expr->term->pattern;
+	return 0;
+}
+
+/* Decides the whole set up front, then jumps to the if holding the first
+ * member that matches, or past the last member. Jumps only cover the members
+ * ahead of any production comparison, which must still run in order. Members
+ * after it are reached normally and take the decision without walking. The
+ * table of targets is filled in as the members are compiled. */
+void LangStmt::compileMatchSet( Compiler *pd, CodeVect &code ) const
+{
+	Pattern *pattern = setPattern();
+	long patSet = pattern->patSet;
+
+	expr->term->varRef->evaluate( pd, code );
+	code.append( IN_MATCH_SET );
+	code.appendHalf( patSet );
+
+	pd->patSetTable[patSet] = code.length();
+	for ( long i = 0; i <= pd->patSetSize[patSet]; i++ )
+		code.appendHalf( 0 );
+}
+
+/* Called where the test of a member has failed. The next member is reached
+ * from here. The last leading member is also the target for all of the
+ * members after it. */
+void LangStmt::setMatchSetTarget( Compiler *pd, CodeVect &code ) const
+{
+	Pattern *pattern = setPattern();
+	long patSet = pattern->patSet;
+	long table = pd->patSetTable[patSet];
+	long size = pd->patSetSize[patSet];
+	long leading = pd->patSetLeading[patSet];
+	long tableEnd = table + SIZEOF_HALF * ( size + 1 );
+
+	if ( pattern->setIndex + 1 < leading ) {
+		code.setHalf( table + SIZEOF_HALF * ( pattern->setIndex + 1 ),
+				code.length() - tableEnd );
+	}
+	else if ( pattern->setIndex + 1 == leading ) {
+		for ( long i = leading; i <= size; i++ )
+			code.setHalf( table + SIZEOF_HALF * i, code.length() - tableEnd );
+	}
+}
+
 void LangStmt::compileWhile( Compiler *pd, CodeVect &code ) const
 {
 	/* Generate code for the while test. Remember the top. */
@@ -2628,6 +2829,12 @@ void LangStmt::compile( Compiler *pd, CodeVect &code ) const
 		case IfType: {
 			long jumpFalse = 0, jumpPastElse = 0, distance = 0;
 
+			findPatternSet( pd );
+
+			Pattern *pattern = setPattern();
+			if ( pattern != 0 && pattern->setIndex == 0 )
+				compileMatchSet( pd, code );
+
 			/* Evaluate the test. */
 			UniqueType *eut = expr->evaluate( pd, code );
 
@@ -2654,6 +2861,9 @@ void LangStmt::compile( Compiler *pd, CodeVect &code ) const
 			distance = code.length() - jumpFalse - 3;
 			code.setHalf( jumpFalse+1, distance );
 
+			if ( pattern != 0 )
+				setMatchSetTarget( pd, code );
+
 			if ( elsePart != 0 ) {
 				/* Compile the else branch. */
 				elsePart->compile( pd, code );
@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -32,6 +33,62 @@
 #include <colm/bytecode.h>
 #include <colm/debug.h>
 
+/* Pointers and strings are used through tree_t. */
+#define OVERLAYS_TREE( type ) \
+	_Static_assert( offsetof( type, refs ) == offsetof( tree_t, refs ) && \
+		offsetof( type, child ) == offsetof( tree_t, child ) && \
+		offsetof( type, value ) == offsetof( tree_t, tokdata ), \
+		#type " must overlay tree_t" )
+
+OVERLAYS_TREE( pointer_t );
+OVERLAYS_TREE( str_t );
+
+/* Explicit stack for the read-only traversals below, which can be called
+ * from outside the VM and so can't use its stack. Starts out in local
+ * storage and moves to the heap when a traversal goes deep. */
+#define WALK_STACK_LOCAL 64
+
+struct walk_stack
+{
+	word_t *data;
+	long len;
+	long alloc;
+	word_t local[WALK_STACK_LOCAL];
+};
+
+static void walk_init( struct walk_stack *ws )
+{
+	ws->data = ws->local;
+	ws->len = 0;
+	ws->alloc = WALK_STACK_LOCAL;
+}
+
+static void walk_push( struct walk_stack *ws, word_t w )
+{
+	if ( ws->len == ws->alloc ) {
+		ws->alloc *= 2;
+		if ( ws->data == ws->local ) {
+			ws->data = malloc( sizeof(word_t) * ws->alloc );
+			memcpy( ws->data, ws->local, sizeof(word_t) * ws->len );
+		}
+		else {
+			ws->data = realloc( ws->data, sizeof(word_t) * ws->alloc );
+		}
+	}
+	ws->data[ws->len++] = w;
+}
+
+static word_t walk_pop( struct walk_stack *ws )
+{
+	return ws->data[--ws->len];
+}
+
+static void walk_clear( struct walk_stack *ws )
+{
+	if ( ws->data != ws->local )
+		free( ws->data );
+}
+
 kid_t *alloc_attrs( program_t *prg, long length )
 {
 	kid_t *cur = 0;
@@ -44,6 +101,27 @@ kid_t *alloc_attrs( program_t *prg, long length )
 	return cur;
 }
 
+/* Gives a tree with no attributes or children yet its attribute and child
+ * kids. Up to KID_BLOCK_MAX kids are allocated as one contiguous block, which
+ * lets attributes and rhs elements be indexed. The block is always the
+ * entire kid list after the ignores and is never relinked. Longer lists fall
+ * back to individually allocated kids. */
+kid_t *alloc_kid_block( program_t *prg, tree_t *tree, long length )
+{
+	kid_t *kids;
+	if ( length == 0 )
+		kids = 0;
+	else if ( length > KID_BLOCK_MAX )
+		kids = alloc_attrs( prg, length );
+	else {
+		kids = kid_block_allocate( prg, length );
+		tree->flags |= AF_KID_BLOCK;
+	}
+
+	tree->child = kid_list_concat( tree->child, kids );
+	return kids;
+}
+
 void free_attrs( program_t *prg, kid_t *attrs )
 {
 	kid_t *cur = attrs;
@@ -65,32 +143,12 @@ void free_kid_list( program_t *prg, kid_t *kid )
 
 static void colm_tree_set_attr( tree_t *tree, long pos, tree_t *val )
 {
-	long i;
-	kid_t *kid = tree->child;
-
-	if ( tree->flags & AF_LEFT_IGNORE )
-		kid = kid->next;
-	if ( tree->flags & AF_RIGHT_IGNORE )
-		kid = kid->next;
-
-	for ( i = 0; i < pos; i++ )
-		kid = kid->next;
-	kid->tree = val;
+	get_attr_kid( tree, pos )->tree = val;
 }
 
 tree_t *colm_get_attr( tree_t *tree, long pos )
 {
-	long i;
-	kid_t *kid = tree->child;
-
-	if ( tree->flags & AF_LEFT_IGNORE )
-		kid = kid->next;
-	if ( tree->flags & AF_RIGHT_IGNORE )
-		kid = kid->next;
-
-	for ( i = 0; i < pos; i++ )
-		kid = kid->next;
-	return kid->tree;
+	return get_attr_kid( tree, pos )->tree;
 }
 
 
@@ -176,6 +234,9 @@ kid_t *get_attr_kid( tree_t *tree, long pos )
 	if ( tree->flags & AF_RIGHT_IGNORE )
 		kid = kid->next;
 
+	if ( tree->flags & AF_KID_BLOCK )
+		return kid + pos;
+
 	for ( i = 0; i < pos; i++ )
 		kid = kid->next;
 	return kid;
@@ -220,7 +281,7 @@ tree_t *colm_construct_term( program_t *prg, word_t id, head_t *tokdata )
 	tree->tokdata = tokdata;
 
 	int object_length = lel_info[tree->id].object_length;
-	tree->child = alloc_attrs( prg, object_length );
+	alloc_kid_block( prg, tree, object_length );
 
 	return tree;
 }
@@ -442,6 +503,53 @@ tree_t *pop_left_ignore( program_t *prg, tree_t **sp, tree_t *pop_from, tree_t *
 	return pop_from;
 }
 
+/* Build the ignore token a lazy ignore list stands for and hang it under the
+ * list, after any ignores merged onto it. The list keeps its identity, so
+ * whoever refers to it sees the expanded form. */
+void colm_ignore_materialize( program_t *prg, tree_t *ignore_list )
+{
+	if ( !( ignore_list->flags & AF_LAZY_IGNORE ) )
+		return;
+
+	tree_t *token = tree_allocate( prg );
+	token->id = ignore_list->prod_num;
+	token->tokdata = ignore_list->tokdata;
+	token->refs = 1;
+
+	kid_t *kid = kid_allocate( prg );
+	kid->tree = token;
+
+	kid_t **tail = &ignore_list->child;
+	while ( *tail != 0 )
+		tail = &(*tail)->next;
+	*tail = kid;
+
+	ignore_list->tokdata = 0;
+	ignore_list->prod_num = 0;
+	ignore_list->flags &= ~( AF_LAZY_IGNORE | AF_HASH_VALID | AF_SUMMARY_VALID );
+}
+
+/* Recover the ignore token from a lazy list, consuming the caller's reference
+ * to the list. An unshared list with nothing merged onto it turns back into
+ * the token it was made from. */
+tree_t *colm_lazy_ignore_token( program_t *prg, tree_t **sp, tree_t *ignore_list )
+{
+	if ( ignore_list->refs == 1 && ignore_list->child == 0 ) {
+		ignore_list->id = ignore_list->prod_num;
+		ignore_list->prod_num = 0;
+		ignore_list->flags &= ~( AF_LAZY_IGNORE | AF_HASH_VALID | AF_SUMMARY_VALID );
+		return ignore_list;
+	}
+
+	tree_t *token = tree_allocate( prg );
+	token->id = ignore_list->prod_num;
+	token->tokdata = string_copy( prg, ignore_list->tokdata );
+	token->refs = 1;
+
+	colm_tree_downref( prg, sp, ignore_list );
+	return token;
+}
+
 tree_t *colm_construct_object( program_t *prg, kid_t *kid, tree_t **bindings, long lang_el_id )
 {
 	struct lang_el_info *lel_info = prg->rtd->lel_info;
@@ -454,11 +562,7 @@ tree_t *colm_construct_object( program_t *prg, kid_t *kid, tree_t **bindings, lo
 	tree->prod_num = 0;
 
 	int object_length = lel_info[tree->id].object_length;
-
-	kid_t *attrs = alloc_attrs( prg, object_length );
-	kid_t *child = 0;
-
-	tree->child = kid_list_concat( attrs, child );
+	alloc_kid_block( prg, tree, object_length );
 
 	return tree;
 }
@@ -510,11 +614,27 @@ tree_t *colm_construct_tree( program_t *prg, kid_t *kid, tree_t **bindings, long
 
 		int object_length = lel_info[tree->id].object_length;
 
-		kid_t *attrs = alloc_attrs( prg, object_length );
-		kid_t *child = construct_kid( prg, bindings,
-				0, nodes[pat].child );
+		long length = object_length, c;
+		for ( c = nodes[pat].child; c != -1; c = nodes[c].next )
+			length += 1;
+
+		if ( length <= KID_BLOCK_MAX ) {
+			/* Children go directly into the block after the attributes. */
+			kid_t *child = alloc_kid_block( prg, tree, length ) + object_length;
+			for ( c = nodes[pat].child; c != -1; c = nodes[c].next ) {
+				child->tree = colm_construct_tree( prg, child, bindings, c );
+				child += 1;
+			}
+		}
+		else {
+			kid_t *attrs = alloc_attrs( prg, object_length );
+			kid_t *child = construct_kid( prg, bindings,
+					0, nodes[pat].child );
 
-		tree->child = kid_list_concat( attrs, child );
+			tree->child = kid_list_concat( attrs, child );
+		}
+
+		colm_tree_summarize( prg, tree );
 
 		/* Right first, then left. */
 		kid_t *ignore = construct_right_ignore_list( prg, pat );
@@ -605,14 +725,12 @@ tree_t *colm_construct_token( program_t *prg, tree_t **args, long nargs )
 		long object_length = lel_info[id].object_length;
 		assert( nargs-2 <= object_length );
 
-		kid_t *attrs = alloc_attrs( prg, object_length );
-
 		tree = tree_allocate( prg );
 		tree->id = id;
 		tree->refs = 1;
 		tree->tokdata = tokdata;
 
-		tree->child = attrs;
+		alloc_kid_block( prg, tree, object_length );
 
 		long i;
 		for ( i = 2; i < nargs; i++ ) {
@@ -672,8 +790,26 @@ tree_t *cast_tree( program_t *prg, int lang_el_id, tree_t *tree )
 	while ( object_length-- > 0 )
 		child = child->next;
 
-	/* Allocate the target type's kids. */
 	object_length = lel_info[lang_el_id].object_length;
+	long length = object_length;
+	kid_t *kid;
+	for ( kid = child; kid != 0; kid = kid->next )
+		length += 1;
+
+	if ( length <= KID_BLOCK_MAX ) {
+		/* Attributes of the target type are left zero. */
+		kid = alloc_kid_block( prg, new_tree, length ) + object_length;
+		while ( child != 0 ) {
+			kid->tree = child->tree;
+			kid->tree->refs += 1;
+			child = child->next;
+			kid += 1;
+		}
+		colm_tree_summarize( prg, new_tree );
+		return new_tree;
+	}
+
+	/* Allocate the target type's kids. */
 	while ( object_length-- > 0 ) {
 		kid_t *new_kid = kid_allocate( prg );
 
@@ -707,6 +843,7 @@ tree_t *cast_tree( program_t *prg, int lang_el_id, tree_t *tree )
 		last = new_kid;
 	}
 	
+	colm_tree_summarize( prg, new_tree );
 	return new_tree;
 }
 
@@ -722,6 +859,19 @@ tree_t *make_tree( program_t *prg, tree_t **args, long nargs )
 	tree->refs = 1;
 
 	long object_length = lel_info[id].object_length;
+
+	if ( object_length + nargs - 1 <= KID_BLOCK_MAX ) {
+		kid_t *kids = alloc_kid_block( prg, tree, object_length + nargs - 1 );
+		kid_t *kid = kids + object_length;
+		for ( id = 1; id < nargs; id++ ) {
+			kid->tree = args[id];
+			colm_tree_upref( prg, kid->tree );
+			kid += 1;
+		}
+		colm_tree_summarize( prg, tree );
+		return tree;
+	}
+
 	kid_t *attrs = alloc_attrs( prg, object_length );
 
 	kid_t *last = 0, *child = 0;
@@ -739,6 +889,7 @@ tree_t *make_tree( program_t *prg, tree_t **args, long nargs )
 	}
 
 	tree->child = kid_list_concat( attrs, child );
+	colm_tree_summarize( prg, tree );
 
 	return tree;
 }
@@ -807,6 +958,10 @@ tree_t *copy_real_tree( program_t *prg, tree_t *tree, kid_t *old_next_down, kid_
 	new_tree->tokdata = string_copy( prg, tree->tokdata );
 	new_tree->prod_num = tree->prod_num;
 
+	/* Same children, same summary. A lazy ignore list stays lazy. */
+	new_tree->flags |= tree->flags & ( AF_SUMMARY_VALID | AF_LAZY_IGNORE );
+	new_tree->summary = tree->summary;
+
 	/* Copy the child list. Start with ignores, then the list. */
 	kid_t *child = tree->child, *last = 0;
 
@@ -834,6 +989,57 @@ tree_t *copy_real_tree( program_t *prg, tree_t *tree, kid_t *old_next_down, kid_
 //		last = newHeader;
 	}
 
+	/* Ignores are always individually allocated kids, shared with the
+	 * original. */
+	long ignores = 0;
+	if ( tree->flags & AF_LEFT_IGNORE )
+		ignores += 1;
+	if ( tree->flags & AF_RIGHT_IGNORE )
+		ignores += 1;
+
+	while ( ignores-- > 0 ) {
+		kid_t *new_kid = kid_allocate( prg );
+
+		if ( child == old_next_down )
+			*new_next_down = new_kid;
+
+		new_kid->tree = child->tree;
+		new_kid->tree->refs += 1;
+
+		if ( last == 0 )
+			new_tree->child = new_kid;
+		else
+			last->next = new_kid;
+
+		child = child->next;
+		last = new_kid;
+	}
+
+	long length = 0;
+	kid_t *kid;
+	for ( kid = child; kid != 0; kid = kid->next )
+		length += 1;
+
+	/* Ignore lists are relinked by the parser, keep them as lists. */
+	if ( tree->id != LEL_ID_IGNORE && length <= KID_BLOCK_MAX ) {
+		kid = alloc_kid_block( prg, new_tree, length );
+		while ( child != 0 ) {
+			/* Watch out for next down. */
+			if ( child == old_next_down )
+				*new_next_down = kid;
+
+			kid->tree = child->tree;
+
+			/* May be an attribute. */
+			if ( kid->tree != 0 )
+				kid->tree->refs += 1;
+
+			child = child->next;
+			kid += 1;
+		}
+		return new_tree;
+	}
+
 	/* Attributes and children. */
 	while ( child != 0 ) {
 		kid_t *new_kid = kid_allocate( prg );
@@ -905,6 +1111,8 @@ void tree_free_rec( program_t *prg, tree_t **sp, tree_t *tree )
 free_tree:
 	switch ( tree->id ) {
 	case LEL_ID_PTR:
+		/* The collector scans pointer trees in the pool. */
+		((pointer_t*)tree)->value = 0;
 		tree_free( prg, tree );
 		break;
 	case LEL_ID_STR: {
@@ -919,13 +1127,24 @@ free_tree:
 
 		/* Attributes and grammar-based children. */
 		kid_t *child = tree->child;
-		while ( child != 0 ) {
+		kid_t *block = tree->flags & AF_KID_BLOCK ? tree_attr( prg, tree ) : 0;
+		while ( child != block ) {
 			kid_t *next = child->next;
 			vm_push_tree( child->tree );
 			kid_free( prg, child );
 			child = next;
 		}
 
+		if ( block != 0 ) {
+			long length = 0;
+			while ( child != 0 ) {
+				vm_push_tree( child->tree );
+				child = child->next;
+				length += 1;
+			}
+			kid_block_free( prg, block, length );
+		}
+
 		tree_free( prg, tree );
 		break;
 	}}
@@ -977,6 +1196,7 @@ free_tree:
 		break;
 	}
 	case LEL_ID_PTR: {
+		((pointer_t*)tree)->value = 0;
 		tree_free( prg, tree );
 		break;
 	}
@@ -986,13 +1206,24 @@ free_tree:
 
 		/* Attributes and grammar-based children. */
 		kid_t *child = tree->child;
-		while ( child != 0 ) {
+		kid_t *block = tree->flags & AF_KID_BLOCK ? tree_attr( prg, tree ) : 0;
+		while ( child != block ) {
 			kid_t *next = child->next;
 			vm_push_tree( child->tree );
 			kid_free( prg, child );
 			child = next;
 		}
 
+		if ( block != 0 ) {
+			long length = 0;
+			while ( child != 0 ) {
+				vm_push_tree( child->tree );
+				child = child->next;
+				length += 1;
+			}
+			kid_block_free( prg, block, length );
+		}
+
 		tree_free( prg, tree );
 		break;
 	}}
@@ -1032,6 +1263,9 @@ kid_t *tree_child( program_t *prg, const tree_t *tree )
 
 	/* Skip over attributes. */
 	long object_length = lel_info[tree->id].object_length;
+	if ( tree->flags & AF_KID_BLOCK )
+		return object_length == 0 ? kid : kid[object_length-1].next;
+
 	long a;
 	for ( a = 0; a < object_length; a++ )
 		kid = kid->next;
@@ -1067,6 +1301,9 @@ kid_t *tree_extract_child( program_t *prg, tree_t *tree )
 	struct lang_el_info *lel_info = prg->rtd->lel_info;
 	kid_t *kid = tree->child, *last = 0;
 
+	/* Only reductions detach children and they never build kid blocks. */
+	assert( !( tree->flags & AF_KID_BLOCK ) );
+
 	if ( tree->flags & AF_LEFT_IGNORE )
 		kid = kid->next;
 	if ( tree->flags & AF_RIGHT_IGNORE )
@@ -1143,8 +1380,25 @@ void ref_set_value( program_t *prg, tree_t **sp, ref_t *ref, tree_t *v )
 	ref->kid->tree = v;
 }
 
+/* Rhs element of a tree with a kid block. Attributes come first in the
+ * block. */
+static kid_t *block_rhs_kid( program_t *prg, const tree_t *lhs, long position )
+{
+	kid_t *kid = lhs->child;
+
+	if ( lhs->flags & AF_LEFT_IGNORE )
+		kid = kid->next;
+	if ( lhs->flags & AF_RIGHT_IGNORE )
+		kid = kid->next;
+
+	return kid + prg->rtd->lel_info[lhs->id].object_length + position;
+}
+
 tree_t *get_rhs_el( program_t *prg, tree_t *lhs, long position )
 {
+	if ( lhs->flags & AF_KID_BLOCK )
+		return block_rhs_kid( prg, lhs, position )->tree;
+
 	kid_t *pos = tree_child( prg, lhs );
 	while ( position > 0 ) {
 		pos = pos->next;
@@ -1155,6 +1409,13 @@ tree_t *get_rhs_el( program_t *prg, tree_t *lhs, long position )
 
 void set_rhs_el( program_t *prg, tree_t *lhs, long position, tree_t *value )
 {
+	lhs->flags &= ~( AF_HASH_VALID | AF_SUMMARY_VALID );
+
+	if ( lhs->flags & AF_KID_BLOCK ) {
+		block_rhs_kid( prg, lhs, position )->tree = value;
+		return;
+	}
+
 	kid_t *pos = tree_child( prg, lhs );
 	while ( position > 0 ) {
 		pos = pos->next;
@@ -1166,6 +1427,9 @@ void set_rhs_el( program_t *prg, tree_t *lhs, long position, tree_t *value )
 
 kid_t *get_rhs_el_kid( program_t *prg, tree_t *lhs, long position )
 {
+	if ( lhs->flags & AF_KID_BLOCK )
+		return block_rhs_kid( prg, lhs, position );
+
 	kid_t *pos = tree_child( prg, lhs );
 	while ( position > 0 ) {
 		pos = pos->next;
@@ -1222,64 +1486,181 @@ tree_t *get_field_split( program_t *prg, tree_t *tree, word_t field )
 	return split;
 }
 
+/* Checks one pattern node against one kid, binding on success. Both null is
+ * a match. */
+static int match_node( tree_t **bindings, program_t *prg, long pat, kid_t *kid )
+{
+	struct pat_cons_node *nodes = prg->rtd->pat_repl_nodes;
+
+	if ( pat == -1 || kid == 0 )
+		return pat == -1 && kid == 0;
+
+	if ( nodes[pat].id != kid->tree->id )
+		return false;
+
+	/* If the pattern node has data, then this means we need to match
+	 * the data against the token data. */
+	if ( nodes[pat].data != 0 ) {
+		/* Check the length of token text. */
+		if ( nodes[pat].length != string_length( kid->tree->tokdata ) )
+			return false;
+
+		/* Check the token text data. */
+		if ( nodes[pat].length > 0 && memcmp( nodes[pat].data, 
+				string_data( kid->tree->tokdata ), nodes[pat].length ) != 0 )
+			return false;
+	}
+
+	/* No failure, all okay. */
+	if ( nodes[pat].bind_id > 0 )
+		bindings[nodes[pat].bind_id] = kid->tree;
+
+	return true;
+}
+
 /* This must traverse in the same order that the bindId assignments are done
- * in. */
+ * in: a node, then its children, then its next siblings. Pending siblings go
+ * on an explicit stack. When both the pattern and tree siblings are absent
+ * nothing is pushed, so right-recursive lists don't grow the stack. */
 int match_pattern( tree_t **bindings, program_t *prg, long pat, kid_t *kid, int check_next )
 {
 	struct pat_cons_node *nodes = prg->rtd->pat_repl_nodes;
+	struct walk_stack ws;
+	int matched = true;
 
-	/* match node, recurse on children. */
-	if ( pat != -1 && kid != 0 ) {
-		if ( nodes[pat].id == kid->tree->id ) {
-			/* If the pattern node has data, then this means we need to match
-			 * the data against the token data. */
-			if ( nodes[pat].data != 0 ) {
-				/* Check the length of token text. */
-				if ( nodes[pat].length != string_length( kid->tree->tokdata ) )
-					return false;
-
-				/* Check the token text data. */
-				if ( nodes[pat].length > 0 && memcmp( nodes[pat].data, 
-						string_data( kid->tree->tokdata ), nodes[pat].length ) != 0 )
-					return false;
-			}
+	walk_init( &ws );
+
+	while ( true ) {
+		if ( ! match_node( bindings, prg, pat, kid ) ) {
+			matched = false;
+			break;
+		}
 
-			/* No failure, all okay. */
-			if ( nodes[pat].bind_id > 0 ) {
-				bindings[nodes[pat].bind_id] = kid->tree;
+		if ( pat != -1 ) {
+			/* If checking next, then save it for after the children. */
+			if ( check_next && ( nodes[pat].next != -1 || kid->next != 0 ) ) {
+				walk_push( &ws, (word_t)nodes[pat].next );
+				walk_push( &ws, (word_t)kid->next );
 			}
 
 			/* If we didn't match a terminal duplicate of a nonterm then check
 			 * down the children. */
 			if ( !nodes[pat].stop ) {
-				/* Check for failure down child branch. */
-				int child_check = match_pattern( bindings, prg, 
-						nodes[pat].child, tree_child( prg, kid->tree ), true );
-				if ( ! child_check )
-					return false;
+				long child_pat = nodes[pat].child;
+				kid_t *child = tree_child( prg, kid->tree );
+				if ( child_pat != -1 || child != 0 ) {
+					pat = child_pat;
+					kid = child;
+					check_next = true;
+					continue;
+				}
 			}
+		}
+
+		if ( ws.len == 0 )
+			break;
 
-			/* If checking next, then look for failure there. */
-			if ( check_next ) {
-				int next_check = match_pattern( bindings, prg, 
-						nodes[pat].next, kid->next, true );
-				if ( ! next_check )
-					return false;
+		kid = (kid_t*)walk_pop( &ws );
+		pat = (long)walk_pop( &ws );
+		check_next = true;
+	}
+
+	walk_clear( &ws );
+	return matched;
+}
+
+/* Parent positions to resume at when a child list ends. */
+struct pat_auto_frame
+{
+	kid_t *next;
+	const struct pat_auto_frame *up;
+};
+
+#define PAT_AUTO_FRAMES 16
+
+/* Tries the alternatives starting at node against the tree position given
+ * by kid and up. Returns the lowest accepting set index below best. Moving
+ * down into a child is a loop when no later alternative remains; only real
+ * choice points recurse, and pattern length bounds them. */
+static long match_auto_node( program_t *prg, long node, kid_t *kid,
+		const struct pat_auto_frame *up, long best )
+{
+	struct pat_auto_node *nodes = prg->rtd->pat_auto_nodes;
+	struct pat_auto_frame frames[PAT_AUTO_FRAMES];
+	int nframes = 0;
+
+	while ( node != -1 && nodes[node].min_accept < best ) {
+		kid_t *next_kid;
+		const struct pat_auto_frame *next_up;
+
+		if ( nodes[node].end ) {
+			if ( kid != 0 ) {
+				node = nodes[node].next;
+				continue;
+			}
+			next_kid = up->next;
+			next_up = up->up;
+		}
+		else {
+			if ( kid == 0 || nodes[node].id != kid->tree->id ||
+					( nodes[node].data != 0 && ( nodes[node].length !=
+					string_length( kid->tree->tokdata ) || memcmp( nodes[node].data,
+					string_data( kid->tree->tokdata ), nodes[node].length ) != 0 ) ) )
+			{
+				node = nodes[node].next;
+				continue;
 			}
 
-			return true;
+			if ( nodes[node].stop ) {
+				next_kid = kid->next;
+				next_up = up;
+			}
+			else {
+				/* Out of frames, carry on from here in a fresh call. */
+				if ( nframes == PAT_AUTO_FRAMES )
+					return match_auto_node( prg, node, kid, up, best );
+
+				frames[nframes].next = kid->next;
+				frames[nframes].up = up;
+				next_kid = tree_child( prg, kid->tree );
+				next_up = &frames[nframes++];
+			}
+		}
+
+		if ( nodes[node].accept != -1 && nodes[node].accept < best )
+			best = nodes[node].accept;
+
+		long alt = nodes[node].next;
+		if ( alt != -1 && nodes[alt].min_accept < best ) {
+			/* A later alternative remains, come back to it. */
+			if ( nodes[node].child != -1 )
+				best = match_auto_node( prg, nodes[node].child, next_kid, next_up, best );
+			node = alt;
+		}
+		else {
+			node = nodes[node].child;
+			kid = next_kid;
+			up = next_up;
 		}
-	}
-	else if ( pat == -1 && kid == 0 ) {
-		/* Both null is a match. */
-		return 1;
 	}
 
-	return false;
+	return best;
 }
 
+/* Finds the first member of a pattern set that matches the tree at kid,
+ * testing shared pattern prefixes once. Returns the number of members if
+ * none match. Bindings are not collected. */
+long colm_match_pattern_set( program_t *prg, long set, kid_t *kid )
+{
+	struct pat_set_info *info = &prg->rtd->pat_sets[set];
+	struct pat_auto_frame root = { 0, 0 };
 
-long colm_cmp_tree( program_t *prg, const tree_t *tree1, const tree_t *tree2 )
+	return match_auto_node( prg, info->root, kid, &root, info->num_members );
+}
+
+
+/* Compares the node data only, not the children. */
+static long cmp_tree_node( const tree_t *tree1, const tree_t *tree2 )
 {
 	long cmpres = 0;
 	if ( tree1 == 0 ) {
@@ -1316,29 +1697,308 @@ long colm_cmp_tree( program_t *prg, const tree_t *tree1, const tree_t *tree2 )
 				return cmpres;
 		}
 	}
+	return 0;
+}
+
+/* Preorder comparison. The remaining siblings at each level are kept on an
+ * explicit stack, and only when there are any, so the last child (where
+ * repeat lists recurse) is compared without growing it. */
+long colm_cmp_tree( program_t *prg, const tree_t *tree1, const tree_t *tree2 )
+{
+	struct walk_stack ws;
+	kid_t *kid1 = 0, *kid2 = 0;
+	long cmpres = 0;
 
-	kid_t *kid1 = tree_child( prg, tree1 );
-	kid_t *kid2 = tree_child( prg, tree2 );
+	walk_init( &ws );
 
 	while ( true ) {
+		/* Identical subtrees need no further work. */
+		if ( tree1 != tree2 ) {
+			cmpres = cmp_tree_node( tree1, tree2 );
+			if ( cmpres != 0 )
+				break;
+
+			if ( tree1 != 0 ) {
+				kid1 = tree_child( prg, tree1 );
+				kid2 = tree_child( prg, tree2 );
+			}
+		}
+
+		/* Find the next pair of kids to compare. */
+		while ( kid1 == 0 && kid2 == 0 && ws.len > 0 ) {
+			kid2 = (kid_t*)walk_pop( &ws );
+			kid1 = (kid_t*)walk_pop( &ws );
+		}
+
 		if ( kid1 == 0 && kid2 == 0 )
+			break;
+		else if ( kid1 == 0 ) {
+			cmpres = -1;
+			break;
+		}
+		else if ( kid2 == 0 ) {
+			cmpres = 1;
+			break;
+		}
+
+		if ( kid1->next != 0 || kid2->next != 0 ) {
+			walk_push( &ws, (word_t)kid1->next );
+			walk_push( &ws, (word_t)kid2->next );
+		}
+
+		tree1 = kid1->tree;
+		tree2 = kid2->tree;
+		kid1 = kid2 = 0;
+	}
+
+	walk_clear( &ws );
+	return cmpres;
+}
+
+static word_t hash_tree_node( const tree_t *tree )
+{
+	word_t h = (word_t)tree->id * (word_t)0x9e3779b97f4a7c15ULL;
+	if ( tree->id == LEL_ID_PTR )
+		h ^= (word_t)((pointer_t*)tree)->value;
+	else if ( tree->id == LEL_ID_STR )
+		h ^= hash_string( ((str_t*)tree)->value );
+	else if ( tree->tokdata != 0 )
+		h ^= hash_string( tree->tokdata );
+	return h;
+}
+
+#define HASH_COMBINE( h, c ) \
+	( ( (h) << 5 | (h) >> ( sizeof(word_t) * 8 - 5 ) ) ^ (c) )
+
+/* Hash consistent with colm_cmp_tree: trees that compare equal hash equally.
+ * The result is cached in the tree and reused until the tree is modified.
+ * Postorder, with the partially hashed ancestors on an explicit stack. */
+word_t colm_hash_tree( program_t *prg, const tree_t *tree )
+{
+	if ( tree == 0 )
+		return 0;
+
+	if ( tree->flags & AF_HASH_VALID )
+		return tree->hash;
+
+	struct walk_stack ws;
+	walk_init( &ws );
+
+	word_t h = hash_tree_node( tree );
+	kid_t *kid = tree_child( prg, tree );
+
+	while ( true ) {
+		/* Combine children with known hashes, stop at the first that needs
+		 * computing. */
+		while ( kid != 0 ) {
+			const tree_t *child = kid->tree;
+			if ( child != 0 && !( child->flags & AF_HASH_VALID ) )
+				break;
+
+			h = HASH_COMBINE( h, child != 0 ? child->hash : 0 );
+			kid = kid->next;
+		}
+
+		if ( kid != 0 ) {
+			/* Descend, saving where we are in this node. */
+			walk_push( &ws, (word_t)tree );
+			walk_push( &ws, (word_t)kid );
+			walk_push( &ws, h );
+
+			tree = kid->tree;
+			h = hash_tree_node( tree );
+			kid = tree_child( prg, tree );
+			continue;
+		}
+
+		tree_t *mut = (tree_t*)tree;
+		mut->hash = (unsigned int)( h ^ ( h >> 16 >> 16 ) );
+		mut->flags |= AF_HASH_VALID;
+
+		if ( ws.len == 0 )
+			break;
+
+		/* Resume the parent after the child just finished. */
+		h = walk_pop( &ws );
+		kid = (kid_t*)walk_pop( &ws );
+		tree = (const tree_t*)walk_pop( &ws );
+
+		h = HASH_COMBINE( h, mut->hash );
+		kid = kid->next;
+	}
+
+	walk_clear( &ws );
+	return tree->hash;
+}
+
+/* Equality only. Differing cached hashes answer without walking the trees. */
+int colm_equal_tree( program_t *prg, const tree_t *tree1, const tree_t *tree2 )
+{
+	if ( tree1 == tree2 )
+		return 1;
+
+	if ( tree1 != 0 && tree2 != 0 && ( tree1->flags & AF_HASH_VALID ) &&
+			( tree2->flags & AF_HASH_VALID ) && tree1->hash != tree2->hash )
+		return 0;
+
+	return colm_cmp_tree( prg, tree1, tree2 ) == 0;
+}
+
+/*
+ * Hash consing. Trees coming out of constructors are rewritten bottom up so
+ * that equal subtrees are shared. The table holds a reference to every
+ * canonical tree, which keeps them shared (refs > 1) and therefore immutable:
+ * any modification splits off a copy first. Entries only the table refers to
+ * are dropped when the table is rebuilt.
+ */
+
+#define CONS_MIN_ALLOC 64
+
+/* Exact equality for nodes whose children are already canonical. Unlike
+ * colm_cmp_tree this includes ignore lists, attributes and token locations,
+ * since the trees must be interchangeable. */
+static int cons_node_eq( program_t *prg, const tree_t *t1, const tree_t *t2 )
+{
+	if ( t1->id != t2->id || t1->prod_num != t2->prod_num )
+		return 0;
+
+	if ( ( t1->flags & ( AF_LEFT_IGNORE | AF_RIGHT_IGNORE ) ) !=
+			( t2->flags & ( AF_LEFT_IGNORE | AF_RIGHT_IGNORE ) ) )
+		return 0;
+
+	if ( t1->id == LEL_ID_PTR ) {
+		if ( ((pointer_t*)t1)->value != ((pointer_t*)t2)->value )
 			return 0;
-		else if ( kid1 == 0 && kid2 != 0 )
-			return -1;
-		else if ( kid1 != 0 && kid2 == 0 )
-			return 1;
+	}
+	else if ( t1->id == LEL_ID_STR ) {
+		if ( cmp_string( ((str_t*)t1)->value, ((str_t*)t2)->value ) != 0 )
+			return 0;
+	}
+	else if ( t1->tokdata != 0 || t2->tokdata != 0 ) {
+		if ( t1->tokdata == 0 || t2->tokdata == 0 )
+			return 0;
+		if ( t1->tokdata->location != t2->tokdata->location )
+			return 0;
+		if ( cmp_string( t1->tokdata, t2->tokdata ) != 0 )
+			return 0;
+	}
+
+	kid_t *k1 = t1->child, *k2 = t2->child;
+	while ( k1 != 0 && k2 != 0 ) {
+		if ( k1->tree != k2->tree )
+			return 0;
+		k1 = k1->next;
+		k2 = k2->next;
+	}
+	return k1 == 0 && k2 == 0;
+}
+
+static void cons_place( program_t *prg, tree_t *tree )
+{
+	long mask = prg->cons_alloc - 1;
+	long pos = tree->hash & mask;
+	while ( prg->cons_table[pos] != 0 )
+		pos = ( pos + 1 ) & mask;
+	prg->cons_table[pos] = tree;
+	prg->cons_len += 1;
+}
+
+/* Rebuild the table, dropping trees that nothing else refers to, and grow it
+ * if it is still more than half full. */
+static void cons_rebuild( program_t *prg, tree_t **sp )
+{
+	long old_alloc = prg->cons_alloc, i;
+	tree_t **old_table = prg->cons_table;
+
+	long live = 0;
+	for ( i = 0; i < old_alloc; i++ ) {
+		if ( old_table[i] != 0 && old_table[i]->refs > 1 )
+			live += 1;
+	}
+
+	long alloc = old_alloc == 0 ? CONS_MIN_ALLOC : old_alloc;
+	while ( ( live + 1 ) * 2 > alloc )
+		alloc *= 2;
+
+	prg->cons_table = (tree_t**) calloc( alloc, sizeof(tree_t*) );
+	prg->cons_alloc = alloc;
+	prg->cons_len = 0;
+
+	for ( i = 0; i < old_alloc; i++ ) {
+		tree_t *tree = old_table[i];
+		if ( tree == 0 )
+			continue;
+
+		if ( tree->refs > 1 )
+			cons_place( prg, tree );
 		else {
-			cmpres = colm_cmp_tree( prg, kid1->tree, kid2->tree );
-			if ( cmpres != 0 )
-				return cmpres;
+			tree->flags &= ~AF_HASH_CONSED;
+			colm_tree_downref( prg, sp, tree );
 		}
-		kid1 = kid1->next;
-		kid2 = kid2->next;
 	}
+
+	free( old_table );
 }
 
+/* Takes a reference to a tree and returns a reference to its canonical
+ * equivalent. Only nodes owned solely by the caller are rewritten; shared
+ * nodes are left as they are and compared by identity. */
+tree_t *colm_hash_cons( program_t *prg, tree_t **sp, tree_t *tree )
+{
+	if ( tree == 0 || ( tree->flags & AF_HASH_CONSED ) || tree->refs > 1 )
+		return tree;
+
+	kid_t *kid;
+	for ( kid = tree->child; kid != 0; kid = kid->next )
+		kid->tree = colm_hash_cons( prg, sp, kid->tree );
 
-void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
+	word_t hash = colm_hash_tree( prg, tree );
+
+	if ( prg->cons_alloc > 0 ) {
+		long mask = prg->cons_alloc - 1;
+		long pos = hash & mask;
+		while ( prg->cons_table[pos] != 0 ) {
+			tree_t *canon = prg->cons_table[pos];
+			if ( canon->hash == hash && cons_node_eq( prg, canon, tree ) ) {
+				colm_tree_upref( prg, canon );
+				colm_tree_downref( prg, sp, tree );
+				return canon;
+			}
+			pos = ( pos + 1 ) & mask;
+		}
+	}
+
+	if ( ( prg->cons_len + 1 ) * 4 > prg->cons_alloc * 3 )
+		cons_rebuild( prg, sp );
+
+	colm_tree_upref( prg, tree );
+	tree->flags |= AF_HASH_CONSED;
+	cons_place( prg, tree );
+	return tree;
+}
+
+void colm_hash_cons_clear( program_t *prg, tree_t **sp )
+{
+	long i;
+	for ( i = 0; i < prg->cons_alloc; i++ ) {
+		tree_t *tree = prg->cons_table[i];
+		if ( tree != 0 ) {
+			tree->flags &= ~AF_HASH_CONSED;
+			colm_tree_downref( prg, sp, tree );
+		}
+	}
+
+	free( prg->cons_table );
+	prg->cons_table = 0;
+	prg->cons_len = 0;
+	prg->cons_alloc = 0;
+}
+
+/* Makes every tree on a reference chain unshared, copying only the shared
+ * trees on the path and nothing beside it. When the tree at the end of the
+ * chain is about to be replaced it is left alone, only the trees above it
+ * need to be private. */
+static void split_ref_path( program_t *prg, tree_t ***psp, ref_t *from_ref, int split_end )
 {
 	/* Go up the chain of kids, turing the pointers down. */
 	ref_t *last = 0, *ref = from_ref, *next = 0;
@@ -1357,6 +2017,17 @@ void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
 			while ( next_down != 0 && next_down->kid == ref->kid )
 				next_down = next_down->next;
 
+			if ( next_down == 0 && !split_end ) {
+				/* At the end and it is going to be replaced. Reset the rest
+				 * of the list without copying. */
+				while ( ref != 0 ) {
+					next = ref->next;
+					ref->next = 0;
+					ref = next;
+				}
+				break;
+			}
+
 			kid_t *old_next_kid_down = next_down != 0 ? next_down->kid : 0;
 			kid_t *new_next_kid_down = 0;
 
@@ -1376,6 +2047,9 @@ void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
 				ref = next;
 			}
 
+			/* About to be modified below this point. */
+			new_tree->flags &= ~( AF_HASH_VALID | AF_SUMMARY_VALID );
+
 			/* Correct kid pointers down from ref. */
 			while ( next_down != 0 && next_down->kid == old_next_kid_down ) {
 				next_down->kid = new_next_kid_down;
@@ -1383,6 +2057,8 @@ void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
 			}
 		}
 		else {
+			ref->kid->tree->flags &= ~( AF_HASH_VALID | AF_SUMMARY_VALID );
+
 			/* Reset the list as we go down. */
 			next = ref->next;
 			ref->next = 0;
@@ -1391,6 +2067,18 @@ void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
 	}
 }
 
+void split_ref( program_t *prg, tree_t ***psp, ref_t *from_ref )
+{
+	split_ref_path( prg, psp, from_ref, true );
+}
+
+/* For assigning through a reference. The old tree at the end is dropped, so
+ * there is no point in copying it. */
+void split_ref_above( program_t *prg, tree_t ***psp, ref_t *from_ref )
+{
+	split_ref_path( prg, psp, from_ref, false );
+}
+
 tree_t *set_list_mem( list_t *list, half_t field, tree_t *value )
 {
 	if ( value != 0 )
@@ -1585,24 +2273,74 @@ tree_t *map_store( program_t *prg, map_t *map, tree_t *key, tree_t *element )
 }
 #endif
 
-static tree_t *tree_search_kid( program_t *prg, kid_t *kid, long id )
+/* Computes the summary of a tree from its children, which must be in place.
+ * Childless children contribute their own id. Left invalid if any other
+ * child's summary is. */
+void colm_tree_summarize( program_t *prg, tree_t *tree )
 {
-	/* This node the one? */
-	if ( kid->tree->id == id )
-		return kid->tree;
+	unsigned int summary = TREE_ID_BIT( tree->id );
+	kid_t *kid = tree_child( prg, tree );
+
+	while ( kid != 0 ) {
+		const tree_t *child = kid->tree;
+		if ( child != 0 ) {
+			if ( child->flags & AF_SUMMARY_VALID )
+				summary |= child->summary;
+			else if ( child->id == LEL_ID_PTR || child->id == LEL_ID_STR ||
+					tree_child( prg, child ) == 0 )
+				summary |= TREE_ID_BIT( child->id );
+			else
+				return;
+		}
+		kid = kid->next;
+	}
+
+	tree->summary = summary;
+	tree->flags |= AF_SUMMARY_VALID;
+}
+
+/* False when the grammar children of a tree certainly don't contain a tree
+ * of the given id. */
+int colm_tree_may_contain( program_t *prg, const tree_t *tree, long id )
+{
+	return !( tree->flags & AF_SUMMARY_VALID ) ||
+			( tree->summary & TREE_ID_BIT( id ) );
+}
 
+/* Preorder search from a kid, covering its subtree and its following
+ * siblings. Siblings are saved on an explicit stack only when present. */
+static tree_t *tree_search_kid( program_t *prg, kid_t *kid, long id )
+{
+	struct walk_stack ws;
 	tree_t *res = 0;
 
-	/* Search children. */
-	kid_t *child = tree_child( prg, kid->tree );
-	if ( child != 0 )
-		res = tree_search_kid( prg, child, id );
-	
-	/* Search siblings. */
-	if ( res == 0 && kid->next != 0 )
-		res = tree_search_kid( prg, kid->next, id );
+	walk_init( &ws );
 
-	return res;	
+	while ( true ) {
+		/* This node the one? */
+		if ( kid->tree->id == id ) {
+			res = kid->tree;
+			break;
+		}
+
+		kid_t *child = colm_tree_may_contain( prg, kid->tree, id ) ?
+				tree_child( prg, kid->tree ) : 0;
+		if ( child != 0 ) {
+			/* Search children first, siblings after. */
+			if ( kid->next != 0 )
+				walk_push( &ws, (word_t)kid->next );
+			kid = child;
+		}
+		else if ( kid->next != 0 )
+			kid = kid->next;
+		else if ( ws.len > 0 )
+			kid = (kid_t*)walk_pop( &ws );
+		else
+			break;
+	}
+
+	walk_clear( &ws );
+	return res;
 }
 
 tree_t *tree_search( program_t *prg, tree_t *tree, long id )
@@ -1610,7 +2348,7 @@ tree_t *tree_search( program_t *prg, tree_t *tree, long id )
 	tree_t *res = 0;
 	if ( tree->id == id )
 		res = tree;
-	else {
+	else if ( colm_tree_may_contain( prg, tree, id ) ) {
 		kid_t *child = tree_child( prg, tree );
 		if ( child != 0 )
 			res = tree_search_kid( prg, child, id );
@@ -1620,22 +2358,34 @@ tree_t *tree_search( program_t *prg, tree_t *tree, long id )
 
 static location_t *loc_search_kid( program_t *prg, kid_t *kid )
 {
-	/* This node the one? */
-	if ( kid->tree->tokdata != 0 && kid->tree->tokdata->location != 0 )
-		return kid->tree->tokdata->location;
-
+	struct walk_stack ws;
 	location_t *res = 0;
 
-	/* Search children. */
-	kid_t *child = tree_child( prg, kid->tree );
-	if ( child != 0 )
-		res = loc_search_kid( prg, child );
-	
-	/* Search siblings. */
-	if ( res == 0 && kid->next != 0 )
-		res = loc_search_kid( prg, kid->next );
+	walk_init( &ws );
 
-	return res;	
+	while ( true ) {
+		/* This node the one? */
+		if ( kid->tree->tokdata != 0 && kid->tree->tokdata->location != 0 ) {
+			res = kid->tree->tokdata->location;
+			break;
+		}
+
+		kid_t *child = tree_child( prg, kid->tree );
+		if ( child != 0 ) {
+			if ( kid->next != 0 )
+				walk_push( &ws, (word_t)kid->next );
+			kid = child;
+		}
+		else if ( kid->next != 0 )
+			kid = kid->next;
+		else if ( ws.len > 0 )
+			kid = (kid_t*)walk_pop( &ws );
+		else
+			break;
+	}
+
+	walk_clear( &ws );
+	return res;
 }
 
 static location_t *loc_search( program_t *prg, tree_t *tree )
@@ -1668,9 +2418,7 @@ head_t *tree_to_str( program_t *prg, tree_t **sp, tree_t *tree, int trim, int at
 		colm_print_tree_collect( prg, sp, &collect, tree, trim );
 
 	/* Set up the input stream. */
-	head_t *ret = string_alloc_full( prg, collect.data, collect.length );
-
-	str_collect_destroy( &collect );
+	head_t *ret = str_collect_take( &collect );
 
 	return ret;
 }
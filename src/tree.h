@@ -222,6 +222,19 @@ void colm_tree_upref_( tree_t *tree );
 void colm_tree_upref( struct colm_program *prg, tree_t *tree );
 void colm_tree_downref( struct colm_program *prg, tree_t **sp, tree_t *tree );
 long colm_cmp_tree( struct colm_program *prg, const tree_t *tree1, const tree_t *tree2 );
+word_t colm_hash_tree( struct colm_program *prg, const tree_t *tree );
+int colm_equal_tree( struct colm_program *prg, const tree_t *tree1, const tree_t *tree2 );
+tree_t *colm_hash_cons( struct colm_program *prg, tree_t **sp, tree_t *tree );
+void colm_hash_cons_clear( struct colm_program *prg, tree_t **sp );
+
+/* Summary bit for a lang el id. */
+#define TREE_ID_BIT( id ) ( 1u << ( (unsigned)(id) & 31 ) )
+
+void colm_tree_summarize( struct colm_program *prg, tree_t *tree );
+int colm_tree_may_contain( struct colm_program *prg, const tree_t *tree, long id );
+
+void colm_ignore_materialize( struct colm_program *prg, tree_t *ignore_list );
+tree_t *colm_lazy_ignore_token( struct colm_program *prg, tree_t **sp, tree_t *ignore_list );
 
 tree_t *push_right_ignore( struct colm_program *prg, tree_t *push_to, tree_t *right_ignore );
 tree_t *push_left_ignore( struct colm_program *prg, tree_t *push_to, tree_t *left_ignore );
@@ -276,6 +289,7 @@ tree_t *tree_search( struct colm_program *prg, tree_t *tree, long id );
 
 int match_pattern( tree_t **bindings, struct colm_program *prg,
 		long pat, kid_t *kid, int check_next );
+long colm_match_pattern_set( struct colm_program *prg, long set, kid_t *kid );
 tree_t *tree_iter_deref_cur( tree_iter_t *iter );
 
 /* For making references of attributes. */
@@ -303,6 +317,7 @@ tree_t *tree_iter_prev_repeat( struct colm_program *prg, tree_t ***psp, tree_ite
  * never down resizes. */
 typedef struct colm_str_collect
 {
+	head_t *head;
 	char *data;
 	int allocated;
 	int length;
@@ -310,6 +325,7 @@ typedef struct colm_str_collect
 } str_collect_t;
 
 void init_str_collect( str_collect_t *collect );
+head_t *str_collect_take( str_collect_t *collect );
 void str_collect_destroy( str_collect_t *collect );
 void str_collect_append( str_collect_t *collect, const char *data, long len );
 void str_collect_clear( str_collect_t *collect );
@@ -325,11 +341,17 @@ void colm_print_tree_file( struct colm_program *prg, tree_t **sp,
 		struct stream_impl_data *impl, tree_t *tree, int trim );
 void colm_print_xml_stdout( struct colm_program *prg, tree_t **sp,
 		struct stream_impl_data *impl, tree_t *tree, int comm_attr, int trim );
+void colm_print_json_file( struct colm_program *prg, tree_t **sp,
+		struct stream_impl_data *impl, tree_t *tree, int flags );
+void colm_print_tree_collect_json( struct colm_program *prg, tree_t **sp,
+		str_collect_t *collect, tree_t *tree, int flags );
 
 void colm_postfix_tree_collect( struct colm_program *prg, tree_t **sp,
 		str_collect_t *collect, tree_t *tree, int trim );
 void colm_postfix_tree_file( struct colm_program *prg, tree_t **sp,
 		struct stream_impl *impl, tree_t *tree, int trim );
+void colm_postfix_bin_tree_collect( struct colm_program *prg, tree_t **sp,
+		str_collect_t *collect, tree_t *tree );
 
 /*
  * Iterators.
@@ -378,6 +400,12 @@ value_t colm_vlist_detach_head( struct colm_program *prg, list_t *list );
 value_t colm_vlist_detach_tail( struct colm_program *prg, list_t *list );
 
 value_t colm_viter_deref_cur( struct colm_program *prg, generic_iter_t *iter );
+tree_t *colm_vector_iter_advance( struct colm_program *prg,
+		tree_t ***psp, generic_iter_t *iter );
+value_t colm_vector_iter_deref_cur( struct colm_program *prg, generic_iter_t *iter );
+tree_t *colm_hashmap_iter_advance( struct colm_program *prg,
+		tree_t ***psp, generic_iter_t *iter );
+value_t colm_hashmap_iter_deref_cur( struct colm_program *prg, generic_iter_t *iter );
 
 str_t *string_prefix( program_t *prg, str_t *str, long len );
 str_t *string_suffix( program_t *prg, str_t *str, long pos );
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2026 Colm contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <colm/pdarun.h>
+#include <colm/program.h>
+#include <colm/struct.h>
+#include <colm/bytecode.h>
+
+/* The vector holds one reference to each tree value. Values pushed or set are
+ * taken over from the caller, and values popped or replaced are handed back.
+ * Reading a value gives the caller a new reference. */
+
+static void colm_vector_grow( struct colm_program *prg, vector_t *vector, long len )
+{
+	if ( len <= vector->alloc )
+		return;
+
+	long alloc = vector->alloc == 0 ? 8 : vector->alloc * 2;
+	while ( alloc < len )
+		alloc *= 2;
+
+	vector->data = (value_t*) realloc( vector->data, sizeof(value_t) * alloc );
+	memset( vector->data + vector->alloc, 0, sizeof(value_t) * ( alloc - vector->alloc ) );
+
+	prg->gc_allocated += sizeof(value_t) * ( alloc - vector->alloc );
+	vector->alloc = alloc;
+}
+
+void colm_vector_destroy( struct colm_program *prg, tree_t **sp, struct colm_struct *s )
+{
+	vector_t *vector = (vector_t*) s;
+	if ( vector->generic_info->value_type == TYPE_TREE ) {
+		long i;
+		for ( i = 0; i < vector->len; i++ )
+			colm_tree_downref( prg, sp, (tree_t*)vector->data[i] );
+	}
+	free( vector->data );
+}
+
+vector_t *colm_vector_new( struct colm_program *prg )
+{
+	size_t memsize = sizeof(struct colm_vector);
+	struct colm_vector *vector = (struct colm_vector*) malloc( memsize );
+	memset( vector, 0, memsize );
+	colm_struct_add( prg, (struct colm_struct *)vector, memsize );
+	vector->id = prg->rtd->struct_inbuilt_id;
+	vector->destructor = &colm_vector_destroy;
+	return vector;
+}
+
+void colm_vector_push( struct colm_program *prg, vector_t *vector, value_t value )
+{
+	colm_vector_grow( prg, vector, vector->len + 1 );
+	vector->data[vector->len++] = value;
+}
+
+value_t colm_vector_pop( struct colm_program *prg, vector_t *vector )
+{
+	if ( vector->len == 0 )
+		return 0;
+
+	value_t value = vector->data[--vector->len];
+	vector->data[vector->len] = 0;
+	return value;
+}
+
+value_t colm_vector_get( struct colm_program *prg, vector_t *vector, long pos )
+{
+	if ( pos < 0 || pos >= vector->len )
+		return 0;
+
+	value_t value = vector->data[pos];
+	if ( vector->generic_info->value_type == TYPE_TREE )
+		colm_tree_upref( prg, (tree_t*)value );
+	return value;
+}
+
+/* Setting past the end extends the vector with nil values. A negative
+ * position stores nothing and hands the value back. */
+value_t colm_vector_set( struct colm_program *prg, vector_t *vector,
+		long pos, value_t value )
+{
+	if ( pos < 0 )
+		return value;
+
+	if ( pos >= vector->len ) {
+		colm_vector_grow( prg, vector, pos + 1 );
+		vector->len = pos + 1;
+	}
+
+	value_t prev = vector->data[pos];
+	vector->data[pos] = value;
+	return prev;
+}
+
+long colm_vector_length( vector_t *vector )
+{
+	return vector->len;
+}
@@ -36,6 +36,11 @@
 #
 # files containing C functions
 #
+###### REDUCER ######
+#
+# Reducer classes, for a host program. Written to reducer.h next to the
+# generated commit code.
+#
 
 #######################################
 
@@ -181,6 +186,7 @@ function runtests()
 		LM=$WORKING/$ROOT.lm
 		HOST=$WORKING/$ROOT.host.cc
 		CALL=$WORKING/$ROOT.call.c
+		RED=$WORKING/$ROOT.red
 		SH=$WORKING/$ROOT.sh
 
 		section LM 0 $TST $LM
@@ -199,6 +205,11 @@ function runtests()
 		section CALL 0 $TST $CALL
 		section HOST 0 $TST $HOST
 
+		if cat_section REDUCER 0 $TST > /dev/null; then
+			mkdir -p $RED
+			section REDUCER 0 $TST $RED/reducer.h
+		fi
+
 		COLM_ADDS=""
 		if test -f $CALL; then
 			COLM_ADDS="-a $CALL"
@@ -213,13 +224,19 @@ function runtests()
 			PARSE=$WORKING/$ROOT.parse
 			IF=$WORKING/$ROOT.if
 
+			COMMIT=""
+			if test -f $RED/reducer.h; then
+				COMMIT=$RED/commit.cc
+				COMP="$COMP -m $COMMIT"
+			fi
+
 			echo $COLM_BIN $COMP -c -o $PARSE.c -e $IF.h -x $IF.cc $LM >> $SH
 			if ! check_compilation $?; then
 				continue
 			fi
 
 			echo gcc -c $COLM_CPPFLAGS $COLM_LDFLAGS -o $PARSE.o $PARSE.c >> $SH
-			echo g++ -I. $COLM_CPPFLAGS $COLM_LDFLAGS -o $WORKING/$ROOT $IF.cc $HOST $PARSE.o -lcolm >> $SH
+			echo g++ -I. $COLM_CPPFLAGS $COLM_LDFLAGS -o $WORKING/$ROOT $IF.cc $COMMIT $HOST $PARSE.o -lcolm >> $SH
 
 			if ! check_compilation $?; then
 				continue
@@ -5,6 +5,7 @@
 #include <colm/tree.h>
 #include <colm/program.h>
 #include <colm/colm.h>
+#include <colm/postfix.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -78,6 +79,7 @@ struct TopLevel
 	/* Generated and called by colm. */
 	void commit_reduce_forward( program_t *prg, tree_t **root,
 			struct pda_run *pda_run, parse_tree_t *pt );
+	COLM_READ_REDUCE_FORWARD
 
 	void loadMachineName( string data );
 	void tryMachineDef( InputLoc &loc, std::string name, 
@@ -112,6 +114,7 @@ struct SectionPass
 	/* Generated and called by colm. */
 	void commit_reduce_forward( program_t *prg, tree_t **root,
 			struct pda_run *pda_run, parse_tree_t *pt );
+	COLM_READ_REDUCE_FORWARD
 };
 
 struct IncludePass
@@ -137,6 +140,7 @@ struct IncludePass
 	/* Generated and called by colm. */
 	void commit_reduce_forward( program_t *prg, tree_t **root,
 			struct pda_run *pda_run, parse_tree_t *pt );
+	COLM_READ_REDUCE_FORWARD
 };
 
 #endif